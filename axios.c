@@ -22,288 +22,3622 @@ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
 SOFTWARE.
 */
 
+#include <signal.h>
+#include <stddef.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
+
+#if defined(__linux__)
+#include <linux/perf_event.h>
+#include <sys/syscall.h>
+#endif
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#include "axios.h"
 
 /*
 Contents:
 
+Options
+  *  enum execution_mode
+  *  enum flush_policy
+  *  struct options
+
 Input Queue
-  *  struct node
-  *  remove_front()
+  *  struct input_queue
+  *  initialize_input_queue(), free_input_queue()
   *  clear_queue()
-  *  add_inputs(): adds elements to the queue from user input
+  *  reserve_inputs()
+  *  add_input()
+  *  remove_input_bit()
+  *  skip_input_bits()
+  *  add_inputs(): adds a line of user input to the queue
+
+Asynchronous I/O
+  *  struct block_ring
+  *  write_all()
+  *  wait_for_ring(), wake_ring()
+  *  put_block(), wait_for_blocks()
+  *  read_ahead(), take_input(): read input ahead of the program for --async-io
+  *  write_behind(): writes output behind the program for --async-io
+  *  start_ring(), stop_ring()
+
+Batch Input
+  *  struct input
+  *  open_input(): opens standard input or the file chosen by --input
+  *  fill_input(): reads a block of input
+  *  enum decode_status, decode_inputs(): converts a block of UTF-8 input to UTF-32 in the queue
+  *  add_batch_inputs(): adds a line of input to the queue from the buffered blocks
+
+Output
+  *  struct output
+  *  open_output(): opens standard output or the file chosen by --output
+  *  start_output(), finish_output(): prepare and write out the output buffer around a program
+  *  flush_output()
+  *  wait_for_output(): writes out the output buffer and waits for the thread chosen by --async-io
+  *  encode_utf_8()
+  *  display_output(): adds a character to the output
 
-display_output()
+Input and Output
+  *  struct io
+  *  initialize_io(), free_io()
+  *  begin_io(), end_io(): print the newlines around a program's I/O
+  *  read_input_bits()
+  *  write_output_bit()
+
+States
+  *  struct state
+
+Superinstructions
+  *  enum opcode
+  *  struct instruction
+  *  compile_superinstructions(): fuses states into instructions for run_program()
+
+Endless Loops
+  *  enum pair_status
+  *  stays_on_cell()
+  *  next_pair()
+  *  mark_endless_loops(): finds branches into loops that never end, for --detect-loops
+  *  run_loop_pairs(), run_endless_loop()
+
+Optimization
+  *  is_silent()
+  *  thread_branches(): sends branches past states whose effect is known
+  *  remove_unreachable_instructions()
+
+Cells
+  *  struct cells
+  *  lowest_one_bit()
+  *  allocate_chunk(), free_chunk()
+  *  initialize_cells(), free_cells()
+  *  word_address()
+  *  add_cell()
+  *  advance_pointer(): changes and moves past a run of cells
+  *  find_one(): moves past zero cells
+
+Checkpoints
+  *  struct checkpoint_header
+  *  request_checkpoint(), start_checkpoints(), stop_checkpoints(): handle SIGUSR1 and --checkpoint-interval
+  *  hash_program()
+  *  write_vectors()
+  *  write_checkpoint(): saves a run to the file chosen by --checkpoint
+  *  read_checkpoint(): restores a run from the file chosen by --resume
 
 run_program()
 
+Threaded Code
+  *  enum handler_kind
+  *  struct threaded_state
+  *  compile_threaded_states(): specializes each state into a handler for run_threaded()
+  *  run_threaded()
+
+Memoization
+  *  struct memo_entry
+  *  run_block(): runs the states of a block within one word
+  *  run_memoized()
+
+Profiling
+  *  struct state_profile
+  *  run_profiled(): runs one state at a time, counting what each state does
+  *  write_profile(): reports the counts
+
+Hardware Counters
+  *  enum counter
+  *  struct counters
+  *  start_counters(), stop_counters(): measure parsing or running with the processor's counters
+  *  print_counters()
+
+Native Code
+  *  struct jit_context
+  *  jit_find_current_word(), jit_add_cell(), jit_word_address(), jit_advance(), jit_scan(), jit_input_output():
+     called by native code
+  *  struct code_buffer
+  *  enum jit_status
+  *  emit(), emit_32(), emit_64(), patch_32(), emit_call(), emit_jump(): write machine code
+  *  emit_store_state(), emit_load_state(), emit_checked_call(), emit_move_pointer()
+  *  compile_native_code(): compiles superinstructions into x86-64 machine code
+  *  run_native_code()
+
+C Code
+  *  c_program_start
+  *  write_c_program(): writes a program as standalone C code
+
 Parse Code
   *  identify_three_byte_operator()
   *  identify_two_byte_operator()
+  *  skip_to_operator(): skips bytes that cannot be operators
+  *  struct state_table
+  *  grow_state_table()
+  *  parse_states(): builds the table of states in a single pass
+  *  parse_messages, parse_program(): print why the states could not be built
+  *  find_source_offsets(): finds where each state begins in the code
+  *  run_states(): compiles and runs the states for the chosen execution mode
+  *  run_state_table(): writes the program as C code or runs it
+  *  struct source_identity, struct cache_header
+  *  identify_source()
+  *  check_cached_states(): rejects states that could not have been parsed
+  *  run_cached_program(): runs the states saved by --cache
+  *  write_program_cache()
   *  read_program()
 
 Input Code
+  *  read_code(): reads a whole file into memory
   *  run_code_from_file()
   *  input_file_name()
+  *  is_option()
+  *  get_options_from_argv()
   *  get_file_from_argv()
   *  run_shell()
 
+Benchmark
+  *  struct benchmark_program, struct benchmark_mode, struct benchmark_result, struct benchmark_run
+  *  current_seconds()
+  *  end_benchmark_run(), run_benchmark_child(): run a program in a child process
+  *  files_match()
+  *  build_input(): makes the input of a synthetic program
+  *  benchmark_program(): runs a program in every execution mode
+  *  read_benchmark_code(), struct code_piece, build_code(): make the programs of the suite
+  *  run_benchmarks(): runs --benchmark
+
+Ensembles
+  *  struct sliced_cells, struct lane_group, struct lane_groups
+  *  add_sliced_cell()
+  *  advance_lanes()
+  *  find_lanes_one()
+  *  add_lane_group(), can_join()
+  *  run_ensemble(): runs a program on up to 64 machines at once, one in each bit of the cells
+  *  run_ensemble_states()
+
+Jobs
+  *  struct job, struct job_range, struct job_pool, struct worker
+  *  read_jobs(): reads the list chosen by --jobs
+  *  run_job(): runs a program with its own input and output
+  *  run_job_ensemble(): runs jobs with the same program together for --ensemble
+  *  compare_job_programs()
+  *  take_job(): takes a job from a worker's own range or steals one from another
+  *  run_worker()
+  *  run_jobs(): runs --jobs
+
+Library: the functions declared in axios.h
+  *  struct axios_program, struct axios_machine
+  *  axios_compile(), axios_free_program()
+  *  axios_create_machine(), axios_free_machine()
+  *  axios_run(): runs a machine for a number of steps
+  *  axios_supply_input(), axios_take_output()
+  *  axios_steps()
+
 menu(): runs menu
-main(): interprets arguments passed at command line
+main(): interprets arguments passed at command line, left out when built as a library with AXIOS_LIBRARY defined
 */
 
 
+// Options
+
+// Ways of running a program, chosen by command-line options
+enum execution_mode {
+    SUPERINSTRUCTIONS,  // run_program(), the default
+    THREADED,           // run_threaded(), chosen by --threaded
+    MEMOIZED,           // run_memoized(), chosen by --memoize
+    NATIVE_CODE         // run_native_code(), chosen by --jit
+};
+
+// Ways of deciding when buffered output is written, chosen by --flush
+enum flush_policy {
+    FLUSH_AUTOMATICALLY,  // FLUSH_ON_NEWLINE when writing to a terminal, or else FLUSH_ON_INPUT
+    FLUSH_ON_NEWLINE,     // After every newline, and before input is read
+    FLUSH_ON_INPUT,       // Before input is read
+    FLUSH_ON_EXIT         // Only when the threshold is reached and when the program ends
+};
+
+// Settings chosen by command-line options
+struct options {
+    enum execution_mode execution_mode;
+    char *c_file_name;       // If set by --emit-c=FILE, the program is written to this file as C code instead of being run
+    char *output_file_name;  // If set by --output=FILE, output is written to this file instead of standard output
+    enum flush_policy flush_policy;
+    size_t flush_threshold;  // Set by --flush=BYTES, or else zero for the default buffer size
+    unsigned char batch_input;  // Set by --batch or --input=FILE, reading input in large blocks with no extra newlines
+    char *batch_file_name;      // If set by --input=FILE, input is read from this file instead of standard input
+    char *profile_file_name;    // If set by --profile=FILE, the program is run by run_profiled() and its counts written here
+    unsigned char benchmark;    // Set by --benchmark, which measures programs in every execution mode instead of running one
+    char *checkpoint_file_name;         // If set by --checkpoint=FILE, run_program() writes checkpoints to this file
+    unsigned int checkpoint_interval;   // Set by --checkpoint-interval=SECONDS, or else zero to only write them on SIGUSR1
+    char *resume_file_name;             // If set by --resume=FILE, run_program() continues from the checkpoint in this file
+    char *jobs_file_name;            // If set by --jobs=FILE, every program listed in this file is run instead of one
+    unsigned int number_of_threads;  // Set by --threads=N, or else zero for one worker thread for each core
+    unsigned char ensemble;          // Set by --ensemble, which runs the jobs sharing a program together in lanes
+    unsigned char detect_loops;      // Set by --detect-loops, which stops or speeds up loops that never end
+    char *cache_file_name;           // If set by --cache=FILE, the states of the program are saved to and run from this file
+    unsigned char async_io;          // Set by --async-io, which reads input and writes output in threads of their own
+    unsigned char counters;          // Set by --counters, which reads hardware counters while parsing and running
+} options;
+
+
+
 // Input Queue
 
-// Node struct used to implement queue for inputting bits
-struct node {
-    unsigned long input_utf_32;
-    struct node *next;
-} *front, *rear;
-
-// Removes the first node of the input queue
-void remove_front() {
-    struct node *nd;
-    nd = front;
-    front = front->next;
-    free(nd);
-}
-
-// Empties the queue, except for the terminal element
-void clear_queue() {
-    while (front->input_utf_32 != 0xFFFFFFFF)
-        remove_front();
-}
-
-// Adds all nodes to the input queue based on the input from input_bits()
-unsigned long add_inputs(unsigned char *ptr, unsigned long input_queue_size) {
-    while (*ptr != '\n') {
-        if (*ptr > 0xEF && *ptr < 0xF8) {
-            if (*(ptr+1) > 0x7F && *(ptr+1) < 0xC0 && *(ptr+2) > 0x7F && *(ptr+2) < 0xC0 && *(ptr+3) > 0x7F && *(ptr+3) < 0xC0) {
-                rear->input_utf_32 = (*ptr - 0xF0) * 0x40000 + (*(ptr+1) - 0x80) * 0x1000 + (*(ptr+2) - 0x80) * 0x40 + *(ptr+3) - 0x80;
-                ptr += 4;
-            } else {
-                fprintf(stderr, "\nInvalid UTF-8 encoding input, cannot convert to UTF-32\n");
-                return 0xFFFFFFFF;
-            }
-        } else if (*ptr > 0xDF && *ptr < 0xF0) {
-            if (*(ptr+1) > 0x7F && *(ptr+1) < 0xC0 && *(ptr+2) > 0x7F && *(ptr+2) < 0xC0) {
-                rear->input_utf_32 = (*ptr - 0xE0) * 0x1000 + (*(ptr+1) - 0x80) * 0x40 + *(ptr+2) - 0x80;
-                ptr += 3;
-            } else {
+// Queue of characters from user input, stored as UTF-32 encodings in a ring buffer that doubles in size when full
+// Bits are read from the front character one at a time, so the queue also records how many of them have been read
+struct input_queue {
+    uint32_t *characters;
+    size_t capacity;  // Always a power of two
+    size_t front;     // Index of the front character
+    size_t size;      // Number of characters, including the front character
+    unsigned char current_input_bit;
+};
+
+// Returns 1 if memory could not be allocated
+int initialize_input_queue(struct input_queue *queue) {
+    queue->capacity = 64;
+    queue->characters = malloc(queue->capacity * sizeof(uint32_t));
+    if (queue->characters == NULL)
+        return 1;
+    queue->front = 0;
+    queue->size = 0;
+    queue->current_input_bit = 0;
+    return 0;
+}
+
+void free_input_queue(struct input_queue *queue) {
+    free(queue->characters);
+}
+
+// Empties the queue
+void clear_queue(struct input_queue *queue) {
+    queue->size = 0;
+    queue->current_input_bit = 0;
+}
+
+// Makes room in the queue for count more characters, doubling the size of the ring buffer as many times as needed
+// Returns 1 if memory could not be allocated
+int reserve_inputs(struct input_queue *queue, size_t count) {
+    while (queue->size + count > queue->capacity) {
+        uint32_t *characters = realloc(queue->characters, queue->capacity * 2 * sizeof(uint32_t));
+        if (characters == NULL)
+            return 1;
+
+        // Characters that wrapped around to the beginning of the buffer are moved to follow the rest
+        if (queue->front + queue->size > queue->capacity)
+            memcpy(characters + queue->capacity, characters, (queue->front + queue->size - queue->capacity) * sizeof(uint32_t));
+        queue->characters = characters;
+        queue->capacity *= 2;
+    }
+    return 0;
+}
+
+// Adds a character to the back of the queue
+// Returns 1 if memory could not be allocated
+int add_input(struct input_queue *queue, uint32_t character) {
+    if (queue->size == queue->capacity && reserve_inputs(queue, 1))
+        return 1;
+    queue->characters[(queue->front + queue->size) & (queue->capacity - 1)] = character;
+    queue->size++;
+    return 0;
+}
+
+// Returns the next bit of the front character, removing the character once all 21 of its bits have been read
+int remove_input_bit(struct input_queue *queue) {
+    int bit = (queue->characters[queue->front] >> queue->current_input_bit) & 1;
+    if (++queue->current_input_bit == 21) {
+        queue->current_input_bit = 0;
+        queue->front = (queue->front + 1) & (queue->capacity - 1);
+        queue->size--;
+    }
+    return bit;
+}
+
+// Removes count bits from the front of the queue without reading them
+void skip_input_bits(struct input_queue *queue, size_t count) {
+    size_t bits = queue->current_input_bit + count;
+    queue->front = (queue->front + bits / 21) & (queue->capacity - 1);
+    queue->size -= bits / 21;
+    queue->current_input_bit = bits % 21;
+}
+
+// Reads a line of user input and adds its characters to the queue, ending with a newline
+// A last line without a newline is given one
+// Returns 1 if there is no more input, the input is not valid UTF-8 or memory could not be allocated
+int add_inputs(struct input_queue *queue, FILE *file) {
+    int c = getc(file);
+    if (c == EOF)
+        return 1;
+
+    while (c != '\n' && c != EOF) {
+        // Finds the number of continuation bytes following the first byte of the character
+        uint32_t input_utf_32;
+        int continuation_bytes;
+        if (c > 0xEF && c < 0xF8) {
+            input_utf_32 = c - 0xF0;
+            continuation_bytes = 3;
+        } else if (c > 0xDF && c < 0xF0) {
+            input_utf_32 = c - 0xE0;
+            continuation_bytes = 2;
+        } else if (c > 0xBF && c < 0xE0) {
+            input_utf_32 = c - 0xC0;
+            continuation_bytes = 1;
+        } else if (c < 0x80) {
+            input_utf_32 = c;
+            continuation_bytes = 0;
+        } else {
+            fprintf(stderr, "\nInvalid UTF-8 encoding input, cannot convert to UTF-32\n");
+            return 1;
+        }
+
+        for (int i = 0; i < continuation_bytes; i++) {
+            c = getc(file);
+            if (c < 0x80 || c > 0xBF) {
                 fprintf(stderr, "\nInvalid UTF-8 encoding input, cannot convert to UTF-32\n");
-                return 0xFFFFFFFF;
+                return 1;
             }
-        } else if (*ptr > 0xBF && *ptr < 0xE0) {
-            if (*(ptr+1) > 0x7F && *(ptr+1) < 0xC0) {
-                rear->input_utf_32 = (*ptr - 0xC0) * 0x40 + *(ptr+1) - 0x80;
-                ptr += 2;
-            } else {
-                fprintf(stderr, "\nInvalid UTF-8 encoding input, cannot convert to UTF-32\n");
-                return 0xFFFFFFFF;
+            input_utf_32 = input_utf_32 * 0x40 + c - 0x80;
+        }
+
+        if (add_input(queue, input_utf_32)) {
+            fprintf(stderr, "\nFailed to allocate memory\n");
+            return 1;
+        }
+        c = getc(file);
+    }
+
+    if (add_input(queue, '\n')) {
+        fprintf(stderr, "\nFailed to allocate memory\n");
+        return 1;
+    }
+    return 0;
+}
+
+
+
+// Asynchronous I/O
+
+#if defined(__unix__) || defined(__APPLE__)
+
+// Number of blocks a ring holds, and so how far its I/O thread can get ahead of or behind the program
+#define RING_BLOCKS 8
+
+// Size of each block of input read ahead by --async-io
+#define READ_AHEAD_SIZE 65536
+
+// Blocks of bytes handed in order from one thread to another by --async-io, between the program and a thread reading its
+// input or writing its output
+// Only the thread adding blocks moves head and only the thread removing them moves tail, so blocks pass between them
+// without a lock, which is only taken for a thread to sleep while the ring is empty or full and for the other to wake it
+struct block_ring {
+    unsigned char *blocks[RING_BLOCKS];
+    size_t lengths[RING_BLOCKS];
+    atomic_size_t head;  // Number of blocks added
+    atomic_size_t tail;  // Number of blocks removed
+    atomic_int sleeping;  // Number of threads waiting, as one may still be waking when the other begins to wait
+    atomic_int closing;  // Set to stop the reading thread
+    size_t offset;       // Number of bytes already taken from the block at the tail, for input
+    int file_descriptor;
+    pthread_mutex_t lock;
+    pthread_cond_t wake;
+    pthread_t thread;
+};
+
+// Writes all of the bytes, continuing after interruptions and partial writes
+void write_all(int file_descriptor, unsigned char bytes[], size_t size) {
+    size_t written = 0;
+    while (written < size) {
+        ssize_t result = write(file_descriptor, bytes + written, size - written);
+        if (result < 0) {
+            if (errno == EINTR)
+                continue;
+            break;
+        }
+        written += result;
+    }
+}
+
+// Sleeps until counter, the head or tail of the ring, no longer holds value or the ring is closing
+// The other thread changes the counter before checking whether to wake this one, and this thread marks itself as
+// sleeping before checking the counter, so one of them always sees the other
+void wait_for_ring(struct block_ring *ring, atomic_size_t *counter, size_t value) {
+    pthread_mutex_lock(&ring->lock);
+    atomic_fetch_add(&ring->sleeping, 1);
+    while (atomic_load(counter) == value && !atomic_load(&ring->closing))
+        pthread_cond_wait(&ring->wake, &ring->lock);
+    atomic_fetch_sub(&ring->sleeping, 1);
+    pthread_mutex_unlock(&ring->lock);
+}
+
+// Wakes the other thread if it is waiting for a change to the ring
+void wake_ring(struct block_ring *ring) {
+    if (atomic_load(&ring->sleeping)) {
+        pthread_mutex_lock(&ring->lock);
+        pthread_cond_broadcast(&ring->wake);
+        pthread_mutex_unlock(&ring->lock);
+    }
+}
+
+// Adds a block to the ring, waiting while it is full
+void put_block(struct block_ring *ring, unsigned char *block, size_t length) {
+    size_t head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+    if (head - atomic_load(&ring->tail) == RING_BLOCKS)
+        wait_for_ring(ring, &ring->tail, head - RING_BLOCKS);
+    ring->blocks[head % RING_BLOCKS] = block;
+    ring->lengths[head % RING_BLOCKS] = length;
+    atomic_store(&ring->head, head + 1);
+    wake_ring(ring);
+}
+
+// Waits until every block added to the ring has been removed
+void wait_for_blocks(struct block_ring *ring) {
+    size_t head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+    size_t tail;
+    while ((tail = atomic_load(&ring->tail)) != head)
+        wait_for_ring(ring, &ring->tail, tail);
+}
+
+// Reads input into the blocks of the ring ahead of the program, ending with an empty block at the end of the input
+// The thread can only be cancelled while it waits in read(), since a program may end before its input does
+void* read_ahead(void *argument) {
+    struct block_ring *ring = argument;
+    pthread_setcancelstate(PTHREAD_CANCEL_DISABLE, NULL);
+    for (size_t head = 0; ; head++) {
+        if (head - atomic_load(&ring->tail) == RING_BLOCKS)
+            wait_for_ring(ring, &ring->tail, head - RING_BLOCKS);
+        if (atomic_load(&ring->closing))
+            return NULL;
+
+        ssize_t result;
+        pthread_setcancelstate(PTHREAD_CANCEL_ENABLE, NULL);
+        do
+            result = read(ring->file_descriptor, ring->blocks[head % RING_BLOCKS], READ_AHEAD_SIZE);
+        while (result < 0 && errno == EINTR);
+        pthread_setcancelstate(PTHREAD_CANCEL_DISABLE, NULL);
+        if (result < 0)
+            result = 0;
+
+        ring->lengths[head % RING_BLOCKS] = result;
+        atomic_store(&ring->head, head + 1);
+        wake_ring(ring);
+        if (result == 0)
+            return NULL;
+    }
+}
+
+// Copies up to size bytes of input from the ring into buffer, waiting for the reading thread if the ring is empty
+// Returns the number of bytes copied, which is zero at the end of the input
+size_t take_input(struct block_ring *ring, unsigned char buffer[], size_t size) {
+    size_t tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+    if (atomic_load(&ring->head) == tail)
+        wait_for_ring(ring, &ring->head, tail);
+
+    // The empty block at the end stays in the ring, so every later call also finds the end of the input
+    size_t length = ring->lengths[tail % RING_BLOCKS];
+    size_t count = length - ring->offset < size ? length - ring->offset : size;
+    memcpy(buffer, ring->blocks[tail % RING_BLOCKS] + ring->offset, count);
+    ring->offset += count;
+    if (length != 0 && ring->offset == length) {
+        ring->offset = 0;
+        atomic_store(&ring->tail, tail + 1);
+        wake_ring(ring);
+    }
+    return count;
+}
+
+// Writes the blocks of output added to the ring, freeing each once written, until a NULL block is added
+void* write_behind(void *argument) {
+    struct block_ring *ring = argument;
+    for (size_t tail = 0; ; tail++) {
+        if (atomic_load(&ring->head) == tail)
+            wait_for_ring(ring, &ring->head, tail);
+        unsigned char *block = ring->blocks[tail % RING_BLOCKS];
+        if (block == NULL)
+            return NULL;
+        write_all(ring->file_descriptor, block, ring->lengths[tail % RING_BLOCKS]);
+        free(block);
+        atomic_store(&ring->tail, tail + 1);
+        wake_ring(ring);
+    }
+}
+
+// Creates a ring for a file and starts the thread that reads or writes it, where blocks are allocated for reading
+// Returns NULL if memory could not be allocated or the thread could not be created
+struct block_ring* start_ring(int file_descriptor, void* (*run)(void*), unsigned char reading) {
+    struct block_ring *ring = calloc(1, sizeof(struct block_ring));
+    if (ring == NULL)
+        return NULL;
+    for (int i = 0; i < RING_BLOCKS && reading; i++) {
+        ring->blocks[i] = malloc(READ_AHEAD_SIZE);
+        if (ring->blocks[i] == NULL) {
+            for (int j = 0; j < i; j++)
+                free(ring->blocks[j]);
+            free(ring);
+            return NULL;
+        }
+    }
+    atomic_init(&ring->head, 0);
+    atomic_init(&ring->tail, 0);
+    atomic_init(&ring->sleeping, 0);
+    atomic_init(&ring->closing, 0);
+    ring->file_descriptor = file_descriptor;
+    pthread_mutex_init(&ring->lock, NULL);
+    pthread_cond_init(&ring->wake, NULL);
+    if (pthread_create(&ring->thread, NULL, run, ring) != 0) {
+        pthread_mutex_destroy(&ring->lock);
+        pthread_cond_destroy(&ring->wake);
+        for (int i = 0; i < RING_BLOCKS && reading; i++)
+            free(ring->blocks[i]);
+        free(ring);
+        return NULL;
+    }
+    return ring;
+}
+
+// Stops the thread of a ring and frees it, after writing every block added to a ring of output
+void stop_ring(struct block_ring *ring, unsigned char reading) {
+    if (reading) {
+        atomic_store(&ring->closing, 1);
+        pthread_mutex_lock(&ring->lock);
+        pthread_cond_broadcast(&ring->wake);
+        pthread_mutex_unlock(&ring->lock);
+        pthread_cancel(ring->thread);
+    } else
+        put_block(ring, NULL, 0);
+    pthread_join(ring->thread, NULL);
+
+    pthread_mutex_destroy(&ring->lock);
+    pthread_cond_destroy(&ring->wake);
+    for (int i = 0; i < RING_BLOCKS && reading; i++)
+        free(ring->blocks[i]);
+    free(ring);
+}
+
+#endif
+
+
+
+// Batch Input
+
+// Number of bytes of input read at a time by --batch and --input=FILE
+#define INPUT_BUFFER_SIZE 65536
+
+// Buffer holding input read in large blocks, used in place of add_inputs() when --batch or --input=FILE is chosen
+// Input still goes into the queue a line at a time, so 21 ones of output discard the same characters they would if
+// the input were typed in
+// The global input is the one chosen on the command line, and each job run by --jobs opens its own
+struct input {
+    unsigned char *buffer;
+    size_t start;  // Index of the first byte not yet decoded
+    size_t end;    // Index following the last byte read
+    uint64_t bytes_read;  // Total read since the input was opened, from which checkpoints find how much was used
+#if defined(__unix__) || defined(__APPLE__)
+    int file_descriptor;
+    struct block_ring *reader;  // Set by --async-io to the ring filled by the thread reading ahead, or else NULL
+#else
+    FILE *file;
+#endif
+} input;
+
+// Opens the file chosen by --input, or standard input if there is none
+// Returns 1 if the file could not be opened or memory could not be allocated
+int open_input(struct input *input, char file_name[]) {
+    input->buffer = malloc(INPUT_BUFFER_SIZE);
+    if (input->buffer == NULL) {
+        fprintf(stderr, "Failed to allocate memory\n");
+        return 1;
+    }
+    input->start = 0;
+    input->end = 0;
+    input->bytes_read = 0;
+
+#if defined(__unix__) || defined(__APPLE__)
+    input->reader = NULL;
+    input->file_descriptor = file_name == NULL ? STDIN_FILENO : open(file_name, O_RDONLY);
+    if (input->file_descriptor < 0) {
+#else
+    input->file = file_name == NULL ? stdin : fopen(file_name, "rb");
+    if (input->file == NULL) {
+#endif
+        fprintf(stderr, "Failed to open file %s\n", file_name);
+        free(input->buffer);
+        return 1;
+    }
+    return 0;
+}
+
+// Closes a file opened by open_input() and frees its buffer, leaving standard input open
+void close_input(struct input *input) {
+    free(input->buffer);
+#if defined(__unix__) || defined(__APPLE__)
+    if (input->reader != NULL)
+        stop_ring(input->reader, 1);
+    if (input->file_descriptor != STDIN_FILENO)
+        close(input->file_descriptor);
+#else
+    if (input->file != stdin)
+        fclose(input->file);
+#endif
+}
+
+// Moves the bytes not yet decoded to the beginning of the buffer and reads as many more as fit after them
+// Returns the number of bytes read, which is zero at the end of the input
+size_t fill_input(struct input *input) {
+    memmove(input->buffer, input->buffer + input->start, input->end - input->start);
+    input->end -= input->start;
+    input->start = 0;
+#if defined(__unix__) || defined(__APPLE__)
+    ssize_t result;
+    if (input->reader != NULL)
+        result = take_input(input->reader, input->buffer + input->end, INPUT_BUFFER_SIZE - input->end);
+    else {
+        do
+            result = read(input->file_descriptor, input->buffer + input->end, INPUT_BUFFER_SIZE - input->end);
+        while (result < 0 && errno == EINTR);
+        if (result < 0)
+            result = 0;
+    }
+#else
+    size_t result = fread(input->buffer + input->end, 1, INPUT_BUFFER_SIZE - input->end, input->file);
+#endif
+    input->end += result;
+    input->bytes_read += result;
+    return result;
+}
+
+// Skips the first count bytes of input before any of it is used, seeking past them in a file or else reading and
+// discarding them, as when reading from a pipe
+// Returns 1 if the input ends first
+int skip_input(struct input *input, uint64_t count) {
+#if defined(__unix__) || defined(__APPLE__)
+    if (input->reader == NULL && lseek(input->file_descriptor, (off_t) count, SEEK_SET) >= 0) {
+        input->bytes_read = count;
+        return 0;
+    }
+#endif
+    while (input->bytes_read < count) {
+        input->start = input->end;
+        if (fill_input(input) == 0)
+            return 1;
+    }
+
+    // The bytes read past count are kept in the buffer
+    input->start = input->end - (input->bytes_read - count);
+    return 0;
+}
+
+// Results of decode_inputs()
+enum decode_status {
+    DECODED,
+    DECODE_OUT_OF_MEMORY,
+    DECODE_INVALID  // The bytes are not valid UTF-8
+};
+
+// Converts UTF-8 bytes to UTF-32 encodings and adds them to the queue, stopping before a character cut off by the end
+// of the bytes, and sets decoded to the number of bytes used
+// Prints nothing, so that the library can reject input without writing to standard error
+// Returns DECODED, or else the reason the bytes could not be added, in which case the queue is left as it was
+enum decode_status decode_inputs(struct input_queue *queue, unsigned char bytes[], size_t length, size_t *decoded) {
+    // No more characters than bytes are added, so the ring buffer never has to grow partway through
+    if (reserve_inputs(queue, length))
+        return DECODE_OUT_OF_MEMORY;
+    uint32_t *characters = queue->characters;
+    size_t mask = queue->capacity - 1;
+    size_t position = (queue->front + queue->size) & mask;
+    size_t count = 0;
+    size_t i = 0;
+    while (i < length) {
+#if defined(__SSE2__)
+        // Widens 16 ASCII bytes to UTF-32 at once, where they fit before the ring buffer wraps around
+        if (length - i >= 16 && queue->capacity - position >= 16) {
+            __m128i block = _mm_loadu_si128((__m128i*) (bytes + i));
+            if (_mm_movemask_epi8(block) == 0) {
+                const __m128i zero = _mm_setzero_si128();
+                __m128i low = _mm_unpacklo_epi8(block, zero), high = _mm_unpackhi_epi8(block, zero);
+                _mm_storeu_si128((__m128i*) (characters + position), _mm_unpacklo_epi16(low, zero));
+                _mm_storeu_si128((__m128i*) (characters + position + 4), _mm_unpackhi_epi16(low, zero));
+                _mm_storeu_si128((__m128i*) (characters + position + 8), _mm_unpacklo_epi16(high, zero));
+                _mm_storeu_si128((__m128i*) (characters + position + 12), _mm_unpackhi_epi16(high, zero));
+                position = (position + 16) & mask;
+                count += 16;
+                i += 16;
+                continue;
             }
-        } else if (*ptr < 0x80)
-            rear->input_utf_32 = *(ptr++);
-        else {
-            fprintf(stderr, "\nInvalid UTF-8 encoding input, cannot convert to UTF-32\n");
-            return 0xFFFFFFFF;
         }
+#endif
+        // Finds the number of continuation bytes following the first byte of the character
+        unsigned char c = bytes[i];
+        uint32_t input_utf_32;
+        size_t continuation_bytes;
+        if (c > 0xEF && c < 0xF8) {
+            input_utf_32 = c - 0xF0;
+            continuation_bytes = 3;
+        } else if (c > 0xDF && c < 0xF0) {
+            input_utf_32 = c - 0xE0;
+            continuation_bytes = 2;
+        } else if (c > 0xBF && c < 0xE0) {
+            input_utf_32 = c - 0xC0;
+            continuation_bytes = 1;
+        } else if (c < 0x80) {
+            input_utf_32 = c;
+            continuation_bytes = 0;
+        } else {
+            return DECODE_INVALID;
+        }
+        if (length - i <= continuation_bytes)
+            break;
+
+        for (size_t j = 1; j <= continuation_bytes; j++) {
+            c = bytes[i + j];
+            if (c < 0x80 || c > 0xBF)
+                return DECODE_INVALID;
+            input_utf_32 = input_utf_32 * 0x40 + c - 0x80;
+        }
+
+        characters[position] = input_utf_32;
+        position = (position + 1) & mask;
+        count++;
+        i += continuation_bytes + 1;
+    }
+    queue->size += count;
+    *decoded = i;
+    return DECODED;
+}
 
-        rear->next = (struct node*) malloc(sizeof(struct node));
-        rear = rear->next;
-        if (rear == NULL) {
+// Adds the next line of input to the queue, including its newline if it has one, reading more input as needed
+// Unlike add_inputs(), a last line without a newline is left as it is, so the program sees exactly the input given
+// Returns 1 if there is no more input, the input is not valid UTF-8 or memory could not be allocated
+int add_batch_inputs(struct input *input, struct input_queue *queue) {
+    size_t size = queue->size;
+    while (1) {
+        unsigned char *bytes = input->buffer + input->start;
+        size_t length = input->end - input->start;
+        unsigned char *newline = memchr(bytes, '\n', length);
+        if (newline != NULL)
+            length = newline - bytes + 1;
+
+        size_t decoded;
+        enum decode_status status = decode_inputs(queue, bytes, length, &decoded);
+        if (status == DECODE_OUT_OF_MEMORY) {
             fprintf(stderr, "\nFailed to allocate memory\n");
-            return 0xFFFFFFFF;
+            return 1;
         }
+        if (status == DECODE_INVALID) {
+            fprintf(stderr, "\nInvalid UTF-8 encoding input, cannot convert to UTF-32\n");
+            return 1;
+        }
+        input->start += decoded;
+        if (newline != NULL)
+            return 0;
 
-        if (++input_queue_size > 1048576) {
-            fprintf(stderr, "\nInput is too long, exceeding limits on memory\n");
-            return 0xFFFFFFFF;
+        if (fill_input(input) == 0) {
+            if (input->start != input->end) {
+                fprintf(stderr, "\nInvalid UTF-8 encoding input, cannot convert to UTF-32\n");
+                return 1;
+            }
+            return queue->size == size;
         }
     }
-    rear->input_utf_32 = '\n';
-    rear->next = (struct node*) malloc(sizeof(struct node));
-    rear = rear->next;
-    rear->input_utf_32 = 0xFFFFFFFF;
-    return input_queue_size + 1;
 }
 
 
 
-// Converts UTF-32 encoding to UTF-8 and prints it to the screen
-void display_output(unsigned long output_utf_32) {
-    unsigned char output_string[5];
-    output_string[4] = 0;
+// Output
+
+// Size of the output buffer, unless a larger threshold is chosen with --flush
+#define OUTPUT_BUFFER_SIZE 65536
+
+// Buffer holding UTF-8 output until it is written in one call
+// Output goes to standard output, or to the file chosen by --output
+// As with input, each job run by --jobs has its own in place of the global output
+struct output {
+    unsigned char *buffer;
+    size_t size;
+    size_t threshold;  // Number of bytes at which the buffer is written
+    enum flush_policy flush_policy;
+    void (*full_handler)();  // If set, called once the buffer has filled and been written, to end a benchmark run early
+    uint64_t bytes_written;  // Total written since the output was opened, recorded in checkpoints
+#if defined(__unix__) || defined(__APPLE__)
+    int file_descriptor;
+    struct block_ring *writer;  // Set by --async-io to the ring emptied by the thread writing behind, or else NULL
+#else
+    FILE *file;
+#endif
+} output;
+
+// Opens the file chosen by --output, or standard output if there is none
+// Returns 1 if the file could not be opened
+int open_output(struct output *output, char file_name[]) {
+#if defined(__unix__) || defined(__APPLE__)
+    // A resumed run keeps the output written before its checkpoint
+    int truncation = options.resume_file_name == NULL ? O_TRUNC : 0;
+    output->file_descriptor = file_name == NULL ? STDOUT_FILENO : open(file_name, O_WRONLY | O_CREAT | truncation, 0666);
+    if (output->file_descriptor < 0) {
+#else
+    output->file = file_name == NULL ? stdout : fopen(file_name, "wb");
+    if (output->file == NULL) {
+#endif
+        fprintf(stderr, "Failed to open file %s\n", file_name);
+        return 1;
+    }
+    return 0;
+}
+
+// Closes a file opened by open_output(), leaving standard output open
+void close_output(struct output *output) {
+#if defined(__unix__) || defined(__APPLE__)
+    if (output->writer != NULL)
+        stop_ring(output->writer, 0);
+    if (output->file_descriptor != STDOUT_FILENO)
+        close(output->file_descriptor);
+#else
+    if (output->file != stdout)
+        fclose(output->file);
+#endif
+}
+
+// Prepares the output buffer before a program runs
+// Returns 1 if memory could not be allocated
+int start_output(struct output *output, enum flush_policy flush_policy, size_t threshold, unsigned char batch_input) {
+    output->threshold = threshold == 0 ? OUTPUT_BUFFER_SIZE : threshold;
+    output->buffer = malloc(output->threshold + 4);
+    if (output->buffer == NULL)
+        return 1;
+    output->size = 0;
+
+    // Standard output is line-buffered on a terminal, so the same is done here unless another policy is chosen
+    // Batch input needs no one to see the output before it is read, so elsewhere it is only written when the buffer fills
+    output->flush_policy = flush_policy;
+    if (flush_policy == FLUSH_AUTOMATICALLY) {
+        enum flush_policy otherwise = batch_input ? FLUSH_ON_EXIT : FLUSH_ON_INPUT;
+#if defined(__unix__) || defined(__APPLE__)
+        output->flush_policy = isatty(output->file_descriptor) ? FLUSH_ON_NEWLINE : otherwise;
+#else
+        output->flush_policy = output->file == stdout ? FLUSH_ON_NEWLINE : otherwise;
+#endif
+    }
+
+    // Text printed before the program, such as the menu, must appear before its output
+    fflush(stdout);
+    return 0;
+}
+
+// Writes all buffered output
+// With --async-io, the buffer is handed to the writing thread instead and replaced by a new one, unless there is no
+// memory for one, in which case it is written here once the thread has caught up
+void flush_output(struct output *output) {
+#if defined(__unix__) || defined(__APPLE__)
+    unsigned char *buffer = output->writer != NULL && output->size != 0 ? malloc(output->threshold + 4) : NULL;
+    if (buffer != NULL) {
+        put_block(output->writer, output->buffer, output->size);
+        output->buffer = buffer;
+    } else if (output->size != 0) {
+        if (output->writer != NULL)
+            wait_for_blocks(output->writer);
+        write_all(output->file_descriptor, output->buffer, output->size);
+    }
+#else
+    fwrite(output->buffer, 1, output->size, output->file);
+    fflush(output->file);
+#endif
+    output->bytes_written += output->size;
+    if (output->full_handler != NULL && output->size >= output->threshold)
+        output->full_handler();
+    output->size = 0;
+}
+
+// Writes all buffered output and waits until it has all been written, even by the thread chosen by --async-io
+void wait_for_output(struct output *output) {
+    flush_output(output);
+#if defined(__unix__) || defined(__APPLE__)
+    if (output->writer != NULL)
+        wait_for_blocks(output->writer);
+#endif
+}
+
+// Writes all buffered output and frees the buffer after a program ends
+void finish_output(struct output *output) {
+    wait_for_output(output);
+    free(output->buffer);
+}
+
+// Converts UTF-32 encoding to UTF-8, writing up to four bytes to output_string, and returns the number of bytes
+// As when printing it as a string, the null character adds nothing
+int encode_utf_8(unsigned long output_utf_32, unsigned char output_string[]) {
     if (output_utf_32 > 0xFFFF) {
         output_string[3] = 0x80 + output_utf_32 % 0x40;
         output_string[2] = 0x80 + output_utf_32 % 0x1000 / 0x40;
         output_string[1] = 0x80 + output_utf_32 % 0x40000 / 0x1000;
         output_string[0] = 0xF0 + output_utf_32 / 0x40000;
+        return 4;
     } else if (output_utf_32 > 0x7FF) {
-        output_string[3] = 0;
         output_string[2] = 0x80 + output_utf_32 % 0x40;
         output_string[1] = 0x80 + output_utf_32 % 0x1000 / 0x40;
         output_string[0] = 0xE0 + output_utf_32 / 0x1000;
+        return 3;
     } else if (output_utf_32 > 0x7F) {
-        output_string[3] = 0;
-        output_string[2] = 0;
         output_string[1] = 0x80 + output_utf_32 % 0x40;
         output_string[0] = 0xC0 + output_utf_32 / 0x40;
-    } else {
-        output_string[3] = 0;
-        output_string[2] = 0;
-        output_string[1] = 0;
+        return 2;
+    } else if (output_utf_32 != 0) {
         output_string[0] = output_utf_32;
+        return 1;
     }
-    printf("%s", output_string);
+    return 0;
 }
 
+// Adds a UTF-32 encoding to the output as UTF-8
+void display_output(struct output *output, unsigned long output_utf_32) {
+    output->size += encode_utf_8(output_utf_32, output->buffer + output->size);
+    if (output->size >= output->threshold || (output_utf_32 == '\n' && output->flush_policy == FLUSH_ON_NEWLINE))
+        flush_output(output);
+}
 
 
-// Runs the program
-void run_program(unsigned long next_states[], unsigned char will_move_pointer[], unsigned char outputs[], unsigned char inputs[], unsigned long number_of_states) {
-    // Initializes variables used for tracking the current state and moving along the cells array
-    unsigned long state = 0;
-    size_t last_bit = 0;
-    size_t capacity = 8;
-    size_t current_bit = 0;
-    unsigned char toggle_bit = 0b00000001;
 
-    // Initializes the cells array, the array of bits on which Axios operates
-    char* cells = calloc(256, sizeof(char));
-    if (cells == NULL) {
-        fprintf(stderr, "Failed to allocate memory\n");
-        return;
-    }
+// Input and Output
 
-    // Initializes variables used for input and the input queue
-    rear = (struct node*) malloc(sizeof(struct node));
-    rear->input_utf_32 = 0xFFFFFFFF;
-    front = rear;
-    unsigned char current_input_bit = 0;
-    unsigned long input_queue_size = 0;
+// Struct holding the variables used for input and output while a program runs
+// Every runner takes one from its caller, so that programs running at once in different threads share no state
+struct io {
+    struct input_queue queue;
+    unsigned long output_utf_32;
+    unsigned long toggle_output;
+    unsigned char will_not_print_extra_line;
+    struct output *output;
+    struct input *input;  // Batch input, or NULL to read user input a line at a time from standard input
+};
 
-    // Initializes variables used for output
-    unsigned long output_utf_32 = 0;
-    unsigned long toggle_output = 0x00000001;
-    unsigned char will_not_print_extra_line = 255;
+// Initializes variables used for input and output, along with the input queue, for a program writing to output and
+// reading from input
+// Returns 1 if memory could not be allocated
+int initialize_io(struct io *io, struct output *output, struct input *input) {
+    io->output = output;
+    io->input = input;
+    if (start_output(output, options.flush_policy, options.flush_threshold, input != NULL))
+        return 1;
+    if (initialize_input_queue(&io->queue)) {
+        finish_output(output);
+        return 1;
+    }
+    io->output_utf_32 = 0;
+    io->toggle_output = 0x00000001;
+    io->will_not_print_extra_line = 255;
+    return 0;
+}
 
-    // Loops through all states until the termination state is reached
-    while (state < number_of_states) {
-        if (inputs[state] == 0)
-            // Changes the current bit
-            // Happens for all states unless user input is requested
-            cells[current_bit/8] ^= toggle_bit;
-        else {
-            // Operates input queue, changing the current bit according to user input
-            // Asks for user input when there are not enough UTF-32 encodings stored
-            if (will_not_print_extra_line) {
-                printf("\n");
-                will_not_print_extra_line = 0;
-            }
-            for (unsigned char i = inputs[state]; i > 0; i--) {
-                while (input_queue_size * 21 < i) {
-                    unsigned char input_string[1024];
-                    fgets((char *) input_string, 1024, stdin);
-                    input_queue_size = add_inputs(input_string, input_queue_size);
-                    if (input_queue_size == 0xFFFFFFFF) {
-                        clear_queue();
-                        free(front);
-                        return;
-                    }
-                }
-                if (current_input_bit == 21) {
-                    remove_front();
-                    current_input_bit = 0;
-                    input_queue_size--;
-                }
-                if ((front->input_utf_32 >> current_input_bit) & 1) {
-                    if (!((cells[current_bit/8] >> current_bit%8) & 1))
-                        cells[current_bit/8] ^= toggle_bit;
-                } else {
-                    if ((cells[current_bit/8] >> current_bit%8) & 1)
-                        cells[current_bit/8] ^= toggle_bit;
-                }
-                current_input_bit++;
-            }
-        }
+// Frees the input queue and writes any output still buffered
+void free_io(struct io *io) {
+    free_input_queue(&io->queue);
+    finish_output(io->output);
+}
 
-        // Outputs characters based on the number of 2 operators in the current state
-        if (outputs[state] != 0) {
-            for (unsigned char i = outputs[state]; i > 0; i--) {
-                if ((cells[current_bit/8] >> current_bit%8) & 1)
-                    output_utf_32 ^= toggle_output;
-                if (toggle_output != 0x00100000)
-                    toggle_output <<= 1;
-                else {
-                    toggle_output = 0x00000001;
-                    if (output_utf_32 != 0x1FFFFF) {
-                        if (will_not_print_extra_line) {
-                            printf("\n");
-                            will_not_print_extra_line = 0;
-                        }
-                        display_output(output_utf_32);
-                    } else {
-                        clear_queue();
-                        current_input_bit = 0;
-                        input_queue_size = 0;
-                    }
-                    output_utf_32 = 0;
-                }
-            }
-        }
+// Prints a newline before a program's first input or output, separating it from the command that ran the program
+// Batch input prints no extra newlines, so that the output holds only what the program writes
+void begin_io(struct io *io) {
+    if (io->will_not_print_extra_line) {
+        if (io->input == NULL)
+            display_output(io->output, '\n');
+        io->will_not_print_extra_line = 0;
+    }
+}
 
-        // If the current state has no 0 operators, shift the pointer forward
-        // If the last bit is reached, add a new bit and return to the beginning
-        // When this process is completed, go to the next state written in code
-        if (will_move_pointer[state]) {
-            if (current_bit != last_bit) {
-                current_bit++;
-                if (toggle_bit != 0b10000000)
-                    toggle_bit <<= 1;
-                else
-                    toggle_bit = 0b00000001;
-            } else {
-                current_bit = 0;
-                toggle_bit = 0b00000001;
-                last_bit++;
-
-                // Reallocates cells array if it requires more elements beyond its current capacity
-                if (last_bit == capacity) {
-                    size_t byte_capacity = capacity / 4;
-                    capacity *= 2;
-                    cells = (char*) realloc(cells, byte_capacity);
-                    if (cells == NULL) {
-                        fprintf(stderr, "Failed to allocate memory\n");
-                        clear_queue();
-                        free(front);
-                        return;
-                    }
-                    for (size_t i = byte_capacity / 2; i < byte_capacity; i++)
-                        cells[i] = 0;
-                }
-            }
-            state++;
-        }
-        // If there are 0 operators and the current bit is one, go to the state marked by next_states
-        else if ((cells[current_bit/8] >> current_bit%8) & 1)
-            state = next_states[state];
-        // If there are 0 operators and the current bit is zero, go to the next state written in code
-        else
-            state++;
+// Prints a newline after a program's last input or output, if there was any
+void end_io(struct io *io) {
+    if (!io->will_not_print_extra_line && io->input == NULL)
+        display_output(io->output, '\n');
+}
+
+// Reads a bit from the input queue for each of a state's 3 operators, where count is the number of 3 operators
+// Each bit replaces the current cell in turn, so only the last one is returned and the others are skipped all at once
+// Asks for user input when fewer bits than that are left unread in the queue
+// Returns -1 if the user's input could not be read, including at the end of batch input
+int read_input_bits(struct io *io, unsigned char count) {
+    while (io->queue.size * 21 - io->queue.current_input_bit < count) {
+        if (io->output->flush_policy != FLUSH_ON_EXIT)
+            flush_output(io->output);
+        if (io->input != NULL ? add_batch_inputs(io->input, &io->queue) : add_inputs(&io->queue, stdin))
+            return -1;
     }
+    skip_input_bits(&io->queue, count - 1);
+    return remove_input_bit(&io->queue);
+}
 
-    clear_queue();
-    free(rear);
-    free(cells);
-    if (!will_not_print_extra_line)
-        printf("\n");
+// Adds a bit to the output, displaying a character each time 21 bits form a valid UTF-32 encoding
+// 21 ones empties the input queue instead
+void write_output_bit(struct io *io, int bit) {
+    if (bit)
+        io->output_utf_32 ^= io->toggle_output;
+    if (io->toggle_output != 0x00100000)
+        io->toggle_output <<= 1;
+    else {
+        io->toggle_output = 0x00000001;
+        if (io->output_utf_32 != 0x1FFFFF) {
+            begin_io(io);
+            display_output(io->output, io->output_utf_32);
+        } else
+            clear_queue(&io->queue);
+        io->output_utf_32 = 0;
+    }
 }
 
 
 
-// Parse Code
+// States
+
+// A state of the program as parsed, packed into 8 bytes so that a program's states take up as few cache lines as possible
+// The termination state is not stored, and its index is the number of states
+struct state {
+    uint32_t next_state;              // The state to go to if the current cell is one, for a state with 0 operators
+    unsigned char will_move_pointer;  // 255 if the state has no 0 operators
+    unsigned char outputs;            // Number of 2 operators
+    unsigned char inputs;             // Number of 3 operators
+};
+
+
+
+// Superinstructions
+
+// Kinds of superinstructions, each covering one or more states
+enum opcode {
+    ADVANCE,         // Changes the current cell and moves the pointer forward, once for each fused state
+    ADVANCE_BRANCH,  // An ADVANCE followed by a state with 0 operators
+    BRANCH,          // Changes the current cell and goes to the target if the cell is one
+    CLEAR,           // A state that repeats itself, changing the current cell once or twice until it becomes zero
+    SCAN,            // A state that moves the pointer followed by a state going back to it, searching for a cell that is one
+    GENERAL_STATE,   // A single state containing 2 or 3 operators
+    HALT,            // The termination state
+    ENDLESS_LOOP     // Added after the termination state by --detect-loops, in place of the target of a branch into a loop
+};
+
+// Instruction struct used by run_program() in place of individual states
+struct instruction {
+    unsigned char opcode;
+    unsigned char will_move_pointer;  // Only used by GENERAL_STATE
+    unsigned char outputs;            // Only used by GENERAL_STATE
+    unsigned char inputs;             // Only used by GENERAL_STATE
+    uint32_t count;                   // Number of fused states that move the pointer
+    uint32_t target;                  // Index of the instruction to go to if a branch is taken, or where ENDLESS_LOOP begins
+    uint32_t first_state;             // Index of the first state the instruction covers, recorded in checkpoints
+};
+
+// Fuses runs of states without I/O into superinstructions and returns the number of instructions
+// States that are the target of a branch always begin a new instruction, so every branch lands on an instruction
+unsigned long compile_superinstructions(struct state states[], unsigned long number_of_states, struct instruction program[]) {
+    unsigned char *is_target = calloc(number_of_states + 1, sizeof(unsigned char));
+    unsigned long *instruction_of_state = malloc((number_of_states + 1) * sizeof(unsigned long));
+    unsigned long *branch_state = malloc((number_of_states + 1) * sizeof(unsigned long));
+    if (is_target == NULL || instruction_of_state == NULL || branch_state == NULL) {
+        fprintf(stderr, "Failed to allocate memory\n");
+        free(is_target);
+        free(instruction_of_state);
+        free(branch_state);
+        return 0;
+    }
+
+    for (unsigned long state = 0; state < number_of_states; state++) {
+        if (!states[state].will_move_pointer)
+            is_target[states[state].next_state] = 255;
+    }
+
+    unsigned long number_of_instructions = 0;
+    unsigned long state = 0;
+    while (state < number_of_states) {
+        struct instruction *instruction = &program[number_of_instructions];
+        instruction_of_state[state] = number_of_instructions;
+        branch_state[number_of_instructions] = state;
+        instruction->will_move_pointer = states[state].will_move_pointer;
+        instruction->outputs = states[state].outputs;
+        instruction->inputs = states[state].inputs;
+        instruction->count = 0;
+        instruction->target = 0;
+        instruction->first_state = state;
+
+        if (states[state].outputs != 0 || states[state].inputs != 0) {
+            instruction->opcode = GENERAL_STATE;
+            state++;
+        } else if (!states[state].will_move_pointer) {
+            instruction->opcode = states[state].next_state == state ? CLEAR : BRANCH;
+            state++;
+        } else {
+            // Fuses every following state that moves the pointer, stopping before states other states go to
+            do {
+                instruction->count++;
+                state++;
+            } while (state < number_of_states && !is_target[state] && states[state].will_move_pointer && states[state].outputs == 0 && states[state].inputs == 0);
+
+            // A state with 0 operators directly after the run is fused as well
+            if (state < number_of_states && !is_target[state] && !states[state].will_move_pointer && states[state].outputs == 0 && states[state].inputs == 0) {
+                instruction->opcode = ADVANCE_BRANCH;
+                branch_state[number_of_instructions] = state;
+                state++;
+            } else
+                instruction->opcode = ADVANCE;
+        }
+        number_of_instructions++;
+    }
+
+    instruction_of_state[number_of_states] = number_of_instructions;
+    program[number_of_instructions].opcode = HALT;
+    program[number_of_instructions].first_state = number_of_states;
+
+    // Converts the states marked by next_state into the instructions that begin with them
+    for (unsigned long i = 0; i < number_of_instructions; i++) {
+        if (!states[branch_state[i]].will_move_pointer)
+            program[i].target = instruction_of_state[states[branch_state[i]].next_state];
+
+        // The pair of states loops over every zero cell after the first, leaving them unchanged
+        if (program[i].opcode == ADVANCE_BRANCH && program[i].count == 1 && program[i].target == i)
+            program[i].opcode = SCAN;
+    }
+
+    free(is_target);
+    free(instruction_of_state);
+    free(branch_state);
+    return number_of_instructions + 1;
+}
+
+
+
+// Endless Loops
+
+// What is known about a pair of an instruction and the value of the current cell on reaching it, found by
+// mark_endless_loops()
+enum pair_status {
+    PAIR_UNVISITED,
+    PAIR_VISITING,  // On the path being followed
+    PAIR_LEAVES,    // Reaches an instruction that moves the pointer, reads input or ends the program
+    PAIR_ENDLESS    // Repeats forever on the same cell
+};
+
+// Returns 1 if an instruction neither moves the pointer nor reads input, so the current cell alone decides where it goes
+int stays_on_cell(struct instruction *instruction) {
+    return instruction->opcode == BRANCH || instruction->opcode == CLEAR || (instruction->opcode == GENERAL_STATE && !instruction->will_move_pointer && instruction->inputs == 0);
+}
+
+// Returns the pair reached after running the instruction of a pair, where a pair is twice the index of the instruction
+// plus the value of the current cell on reaching it
+// A branch already redirected to an ENDLESS_LOOP instruction is followed to the instruction it remembers
+unsigned long next_pair(struct instruction program[], unsigned long pair) {
+    unsigned long index = pair / 2;
+    if (program[index].opcode == CLEAR)
+        return (index + 1) * 2;
+
+    // The cell changes, and the branch is taken if it becomes one
+    unsigned long target = program[index].target;
+    if (program[target].opcode == ENDLESS_LOOP)
+        target = program[target].target;
+    return pair % 2 == 0 ? target * 2 + 1 : (index + 1) * 2;
+}
+
+// Redirects every branch into an endless loop to an ENDLESS_LOOP instruction added after the termination state, which
+// remembers the instruction the branch went to, and returns the new number of instructions
+// The pointer only ever moves forward, and each time it passes the end of the cells array a new cell is added, so a
+// program can only repeat itself exactly by staying on one cell, where each pair always leads to the same next pair
+// A taken branch always leaves the cell set to one, so whether it enters an endless loop is known before running
+// The program must have room for one more instruction for each instruction before the termination state
+// Returns 0 if memory could not be allocated
+unsigned long mark_endless_loops(struct instruction program[], unsigned long number_of_instructions) {
+    unsigned long number_of_pairs = number_of_instructions * 2;
+    unsigned char *status = calloc(number_of_pairs, sizeof(unsigned char));
+    unsigned long *path = malloc(number_of_pairs * sizeof(unsigned long));
+    unsigned long *loop_instruction = calloc(number_of_instructions, sizeof(unsigned long));
+    if (status == NULL || path == NULL || loop_instruction == NULL) {
+        fprintf(stderr, "Failed to allocate memory\n");
+        free(status);
+        free(path);
+        free(loop_instruction);
+        return 0;
+    }
+
+    // Follows the pairs from each one not yet visited, until reaching a pair that leaves the cell, a pair already
+    // known, or a pair on the same path, which begins a new endless loop
+    for (unsigned long start = 0; start < number_of_pairs; start++) {
+        unsigned long length = 0;
+        unsigned long pair = start;
+        while (status[pair] == PAIR_UNVISITED && stays_on_cell(&program[pair / 2])) {
+            status[pair] = PAIR_VISITING;
+            path[length++] = pair;
+            pair = next_pair(program, pair);
+        }
+        unsigned char result = status[pair] == PAIR_VISITING || status[pair] == PAIR_ENDLESS ? PAIR_ENDLESS : PAIR_LEAVES;
+        if (status[pair] == PAIR_UNVISITED)
+            status[pair] = PAIR_LEAVES;
+        while (length > 0)
+            status[path[--length]] = result;
+    }
+
+    unsigned long new_number_of_instructions = number_of_instructions;
+    for (unsigned long i = 0; i < number_of_instructions; i++) {
+        struct instruction *instruction = &program[i];
+        int branches = instruction->opcode == BRANCH || instruction->opcode == ADVANCE_BRANCH || (instruction->opcode == GENERAL_STATE && !instruction->will_move_pointer);
+        unsigned long target = instruction->target;
+        if (!branches || status[target * 2 + 1] != PAIR_ENDLESS)
+            continue;
+        if (loop_instruction[target] == 0) {
+            program[new_number_of_instructions] = (struct instruction) {ENDLESS_LOOP, 0, 0, 0, 0, target, program[target].first_state};
+            loop_instruction[target] = new_number_of_instructions++;
+        }
+        instruction->target = loop_instruction[target];
+    }
+
+    free(status);
+    free(path);
+    free(loop_instruction);
+    return new_number_of_instructions;
+}
+
+// Runs an endless loop from a pair one instruction at a time, writing its output as usual and never returning
+// Used by run_endless_loop() when there is no memory to find the characters the loop writes
+void run_loop_pairs(struct instruction program[], unsigned long pair, struct io *io) {
+    while (1) {
+        for (unsigned char i = program[pair / 2].outputs; i > 0; i--)
+            write_output_bit(io, pair % 2 == 0);
+        pair = next_pair(program, pair);
+    }
+}
+
+// Runs an endless loop entered by a branch to the instruction start, which stays on the current cell forever
+// A loop writing n bits each time around writes the same n characters every 21 times around once the character being
+// written holds only bits from the loop, so those characters are found once and then written over and over without
+// running the loop. A loop that writes nothing is stopped with a message instead, since it can do nothing else
+void run_endless_loop(struct instruction program[], unsigned long start, struct io *io) {
+    unsigned long number_of_instructions = start + 1;
+    while (program[number_of_instructions - 1].opcode != HALT)
+        number_of_instructions++;
+    unsigned char *visited = calloc(number_of_instructions * 2, sizeof(unsigned char));
+    if (visited == NULL)
+        run_loop_pairs(program, start * 2 + 1, io);
+
+    // Runs the instructions until a pair repeats, writing their output as usual
+    // A taken branch leaves the cell set to one, and each instruction outputs the cell it reaches after changing it
+    unsigned long pair = start * 2 + 1;
+    while (!visited[pair]) {
+        for (unsigned char i = program[pair / 2].outputs; i > 0; i--)
+            write_output_bit(io, pair % 2 == 0);
+        visited[pair] = 1;
+        pair = next_pair(program, pair);
+    }
+    free(visited);
+    unsigned long loop_start = pair;
+    size_t bits_in_loop = 0;
+    do {
+        bits_in_loop += program[pair / 2].outputs;
+        pair = next_pair(program, pair);
+    } while (pair != loop_start);
+
+    // Runs the loop 21 more times so the character being written holds only bits from the loop, then finds the
+    // characters written by the next 21 times around without writing them
+    unsigned long *characters = malloc((bits_in_loop + 1) * sizeof(unsigned long));
+    if (characters == NULL)
+        run_loop_pairs(program, pair, io);
+    for (int time = 0; time < 21 && bits_in_loop != 0; time++) {
+        do {
+            for (unsigned char i = program[pair / 2].outputs; i > 0; i--)
+                write_output_bit(io, pair % 2 == 0);
+            pair = next_pair(program, pair);
+        } while (pair != loop_start);
+    }
+    unsigned long output_utf_32 = io->output_utf_32;
+    unsigned long toggle_output = io->toggle_output;
+    size_t number_of_characters = 0;
+    int shows_anything = 0;
+    for (int time = 0; time < 21 && bits_in_loop != 0; time++) {
+        do {
+            for (unsigned char i = program[pair / 2].outputs; i > 0; i--) {
+                if (pair % 2 == 0)
+                    output_utf_32 ^= toggle_output;
+                if (toggle_output != 0x00100000)
+                    toggle_output <<= 1;
+                else {
+                    toggle_output = 0x00000001;
+                    characters[number_of_characters++] = output_utf_32;
+                    if (output_utf_32 != 0 && output_utf_32 != 0x1FFFFF)
+                        shows_anything = 1;
+                    output_utf_32 = 0;
+                }
+            }
+            pair = next_pair(program, pair);
+        } while (pair != loop_start);
+    }
+
+    if (!shows_anything) {
+        fprintf(stderr, "\nState %lu begins a loop that never ends or writes anything, so the program was stopped\n", (unsigned long) program[loop_start / 2].first_state);
+        free(characters);
+        return;
+    }
+    // characters is never freed, since the output is written until the program is stopped from outside
+    begin_io(io);
+    while (1) {
+        for (size_t i = 0; i < number_of_characters; i++) {
+            if (characters[i] != 0x1FFFFF)
+                display_output(io->output, characters[i]);
+        }
+    }
+}
+
+
+
+// Optimization
+
+// Marks a pair that thread_branches() cannot send a branch further than
+#define NO_PAIR ((unsigned long) -1)
+
+// Returns 1 if a state neither moves the pointer, reads input nor writes output, so that from a known cell it always
+// does the same thing and has no other effect
+int is_silent(struct state states[], unsigned long number_of_states, unsigned long state) {
+    return state < number_of_states && !states[state].will_move_pointer && states[state].inputs == 0 && states[state].outputs == 0;
+}
+
+// Sends each branch straight past the silent states it would run next
+// A taken branch always leaves the cell set to one, so the states run from there while the pointer stays on the cell
+// are known, and the branch can go instead to the last state among them that is reached with the cell set to one. As in
+// mark_endless_loops(), a pair is twice the index of a state plus the value of the cell on reaching it
+// Returns 1 if memory could not be allocated, in which case the states are left unchanged
+int thread_branches(struct state states[], unsigned long number_of_states) {
+    unsigned long number_of_pairs = (number_of_states + 1) * 2;
+    unsigned char *status = calloc(number_of_pairs, sizeof(unsigned char));
+    unsigned long *furthest = malloc(number_of_pairs * sizeof(unsigned long));
+    unsigned long *path = malloc(number_of_pairs * sizeof(unsigned long));
+    if (status == NULL || furthest == NULL || path == NULL) {
+        free(status);
+        free(furthest);
+        free(path);
+        return 1;
+    }
+
+    // Follows the silent states from each pair, then records for each pair on the way the furthest pair reached with
+    // the cell set to one, including the pair the path ends on
+    // Any such pair on the way would do, so a path that loops forever needs no special case
+    for (unsigned long start = 1; start < number_of_pairs; start += 2) {
+        unsigned long length = 0;
+        unsigned long pair = start;
+        while (status[pair] == PAIR_UNVISITED && is_silent(states, number_of_states, pair / 2)) {
+            status[pair] = PAIR_VISITING;
+            path[length++] = pair;
+            pair = pair % 2 == 0 ? states[pair / 2].next_state * 2 + 1 : (pair / 2 + 1) * 2;
+        }
+        unsigned long result;
+        if (status[pair] == PAIR_VISITING)
+            result = NO_PAIR;
+        else if (status[pair] == PAIR_LEAVES)
+            result = furthest[pair];
+        else {
+            result = pair % 2 == 1 ? pair : NO_PAIR;
+            status[pair] = PAIR_LEAVES;
+            furthest[pair] = result;
+        }
+        while (length > 0) {
+            pair = path[--length];
+            if (result == NO_PAIR && pair % 2 == 1)
+                result = pair;
+            status[pair] = PAIR_LEAVES;
+            furthest[pair] = result;
+        }
+    }
+
+    for (unsigned long state = 0; state < number_of_states; state++) {
+        if (states[state].will_move_pointer)
+            continue;
+        unsigned long pair = furthest[states[state].next_state * 2 + 1];
+        if (pair != NO_PAIR)
+            states[state].next_state = pair / 2;
+    }
+
+    free(status);
+    free(furthest);
+    free(path);
+    return 0;
+}
+
+// Removes the instructions that can never run, which are found by following every pair of an instruction and the value
+// of the current cell that can be reached from the first instruction, where the value is unknown after the pointer
+// moves or input is read. Each instruction keeps its first state, and branches are renumbered
+// Returns the new number of instructions, or 0 if memory could not be allocated
+unsigned long remove_unreachable_instructions(struct instruction program[], unsigned long number_of_instructions) {
+    unsigned long number_of_pairs = number_of_instructions * 2;
+    unsigned char *reached = calloc(number_of_pairs, sizeof(unsigned char));
+    unsigned long *pending = malloc(number_of_pairs * sizeof(unsigned long));
+    unsigned long *new_index = malloc(number_of_instructions * sizeof(unsigned long));
+    if (reached == NULL || pending == NULL || new_index == NULL) {
+        fprintf(stderr, "Failed to allocate memory\n");
+        free(reached);
+        free(pending);
+        free(new_index);
+        return 0;
+    }
+
+    unsigned long number_pending = 1;
+    pending[0] = 0;
+    reached[0] = 1;
+    while (number_pending > 0) {
+        unsigned long pair = pending[--number_pending];
+        unsigned long index = pair / 2;
+        struct instruction *instruction = &program[index];
+        unsigned long next[2];
+        int number_of_next = 0;
+        if (instruction->opcode == HALT)
+            continue;
+        if (stays_on_cell(instruction))
+            next[number_of_next++] = next_pair(program, pair);
+        else if (instruction->opcode == ADVANCE_BRANCH || (instruction->opcode == GENERAL_STATE && !instruction->will_move_pointer)) {
+            next[number_of_next++] = instruction->target * 2 + 1;
+            next[number_of_next++] = (index + 1) * 2;
+        } else {
+            next[number_of_next++] = (index + 1) * 2;
+            next[number_of_next++] = (index + 1) * 2 + 1;
+        }
+        for (int i = 0; i < number_of_next; i++) {
+            if (!reached[next[i]]) {
+                reached[next[i]] = 1;
+                pending[number_pending++] = next[i];
+            }
+        }
+    }
+
+    // Moves each instruction that can run down into place, and sends branches to instructions that cannot run, which
+    // are never taken, to the next one that can. The termination state is always kept
+    unsigned long last = number_of_instructions - 1;
+    unsigned long new_number_of_instructions = 0;
+    for (unsigned long i = 0; i < number_of_instructions; i++) {
+        new_index[i] = new_number_of_instructions;
+        if (reached[i * 2] || reached[i * 2 + 1] || i == last)
+            program[new_number_of_instructions++] = program[i];
+    }
+    for (unsigned long i = 0; i < new_number_of_instructions; i++) {
+        struct instruction *instruction = &program[i];
+        if (instruction->opcode == BRANCH || instruction->opcode == ADVANCE_BRANCH || instruction->opcode == CLEAR || instruction->opcode == SCAN || (instruction->opcode == GENERAL_STATE && !instruction->will_move_pointer))
+            instruction->target = new_index[instruction->target];
+    }
+
+    free(reached);
+    free(pending);
+    free(new_index);
+    return new_number_of_instructions;
+}
+
+
+
+// Cells
+
+// The cells array is stored in chunks of 64-bit words, with the first cell in the lowest bit of the first word
+// Each chunk holds 2 MiB, the size of a huge page, and chunks are never moved once allocated, so growing the
+// cells array never copies existing cells
+// A chunk in which every cell is zero may be left unallocated, as a null pointer, so a long cells array that is
+// mostly zero only takes memory for the parts holding ones. Chunks are allocated when the pointer first enters them,
+// and find_one() frees those it passes over that have returned to all zero. The first chunk is always allocated
+#ifndef CHUNK_WORDS
+#define CHUNK_WORDS 262144
+#endif
+#define CHUNK_BITS (CHUNK_WORDS * 64)
+
+struct cells {
+    uint64_t **chunks;        // Null for each chunk that is not allocated
+    size_t number_of_chunks;
+    size_t chunk_capacity;  // Number of chunk pointers allocated
+    size_t last_bit;
+};
+
+// Returns the position of the lowest one bit in a nonzero word
+unsigned char lowest_one_bit(uint64_t word) {
+#if defined(__GNUC__)
+    return __builtin_ctzll(word);
+#else
+    unsigned char position = 0;
+    while (!(word & 1)) {
+        word >>= 1;
+        position++;
+    }
+    return position;
+#endif
+}
+
+// Allocates a chunk in which every cell is zero
+// Where possible, the chunk is mapped directly from the operating system, which supplies zeroed pages as they are first
+// used, and aligned so it can be backed by a huge page
+uint64_t* allocate_chunk() {
+#if defined(__unix__) || defined(__APPLE__)
+    size_t size = CHUNK_WORDS * sizeof(uint64_t);
+    char *mapping = mmap(NULL, 2 * size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (mapping == MAP_FAILED)
+        return NULL;
+
+    // Unmaps the parts of the mapping before and after the aligned chunk
+    size_t offset = (size - (uintptr_t) mapping % size) % size;
+    if (offset != 0)
+        munmap(mapping, offset);
+    munmap(mapping + offset + size, size - offset);
+#if defined(MADV_HUGEPAGE)
+    madvise(mapping + offset, size, MADV_HUGEPAGE);
+#endif
+    return (uint64_t*) (mapping + offset);
+#else
+    return calloc(CHUNK_WORDS, sizeof(uint64_t));
+#endif
+}
+
+void free_chunk(uint64_t *chunk) {
+#if defined(__unix__) || defined(__APPLE__)
+    munmap(chunk, CHUNK_WORDS * sizeof(uint64_t));
+#else
+    free(chunk);
+#endif
+}
+
+// Initializes the cells array with one chunk, of which only the first cell is used
+// Returns 1 if memory could not be allocated
+int initialize_cells(struct cells *cells) {
+    cells->chunk_capacity = 16;
+    cells->chunks = malloc(cells->chunk_capacity * sizeof(uint64_t*));
+    if (cells->chunks == NULL)
+        return 1;
+    cells->chunks[0] = allocate_chunk();
+    if (cells->chunks[0] == NULL) {
+        free(cells->chunks);
+        return 1;
+    }
+    cells->number_of_chunks = 1;
+    cells->last_bit = 0;
+    return 0;
+}
+
+void free_cells(struct cells *cells) {
+    for (size_t i = 0; i < cells->number_of_chunks; i++) {
+        if (cells->chunks[i] != NULL)
+            free_chunk(cells->chunks[i]);
+    }
+    free(cells->chunks);
+}
+
+// Returns the location of a word within its chunk, allocating the chunk first if it is not allocated
+// Returns NULL if memory could not be allocated
+uint64_t* word_address(struct cells *cells, size_t word_index) {
+    uint64_t **chunk = &cells->chunks[word_index / CHUNK_WORDS];
+    if (*chunk == NULL) {
+        *chunk = allocate_chunk();
+        if (*chunk == NULL)
+            return NULL;
+    }
+    return *chunk + word_index % CHUNK_WORDS;
+}
+
+// Adds a new bit to the end of the cells array, adding an unallocated chunk when the last one is full
+// Only the list of chunk pointers is ever reallocated, and it doubles in size each time
+// Returns 1 if memory could not be allocated
+int add_cell(struct cells *cells) {
+    cells->last_bit++;
+    if (cells->last_bit == cells->number_of_chunks * CHUNK_BITS) {
+        if (cells->number_of_chunks == cells->chunk_capacity) {
+            uint64_t **chunks = realloc(cells->chunks, 2 * cells->chunk_capacity * sizeof(uint64_t*));
+            if (chunks == NULL)
+                return 1;
+            cells->chunks = chunks;
+            cells->chunk_capacity *= 2;
+        }
+        cells->chunks[cells->number_of_chunks] = NULL;
+        cells->number_of_chunks++;
+    }
+    return 0;
+}
+
+// Changes the current cell and moves the pointer forward, count times in a row
+// If the last bit is reached, a new bit is added and the pointer returns to the beginning
+// The chunk the pointer ends in is always allocated
+// Returns 1 if memory could not be allocated
+int advance_pointer(struct cells *cells, size_t *current_bit, unsigned long count) {
+    while (count > 0) {
+        if (*current_bit == cells->last_bit) {
+            uint64_t *word = word_address(cells, *current_bit / 64);
+            if (word == NULL)
+                return 1;
+            *word ^= (uint64_t) 1 << *current_bit % 64;
+            *current_bit = 0;
+            count--;
+            if (add_cell(cells))
+                return 1;
+            continue;
+        }
+
+        // Changes as many cells as possible before the last bit, a whole word at a time
+        size_t run = cells->last_bit - *current_bit;
+        if (run > count)
+            run = count;
+        size_t bit = *current_bit;
+        size_t end = bit + run;
+        while (bit < end) {
+            size_t length = 64 - bit % 64;
+            if (length > end - bit)
+                length = end - bit;
+            uint64_t *word = word_address(cells, bit / 64);
+            if (word == NULL)
+                return 1;
+            if (length == 64)
+                *word = ~*word;
+            else
+                *word ^= (((uint64_t) 1 << length) - 1) << bit % 64;
+            bit += length;
+        }
+        *current_bit = end;
+        count -= run;
+    }
+    return word_address(cells, *current_bit / 64) == NULL;
+}
+
+// Moves the pointer past zero cells, a whole word at a time and a whole chunk at a time for unallocated chunks, until
+// it reaches a one cell
+// Passing a zero last bit adds a new bit and returns the pointer to the beginning, as advance_pointer() would
+// Each chunk passed over from its first cell that turns out to be all zero is freed, other than the first chunk
+// Returns 1 if memory could not be allocated
+int find_one(struct cells *cells, size_t *current_bit) {
+    size_t bit = *current_bit;
+    while (1) {
+        size_t chunk = bit / CHUNK_BITS;
+        size_t last_chunk = cells->last_bit / CHUNK_BITS;
+        uint64_t *words = cells->chunks[chunk];
+        if (words != NULL) {
+            // Cells after the last bit are always zero, so only the word holding it needs to be masked
+            size_t first_word = bit % CHUNK_BITS / 64;
+            size_t end_word = chunk == last_chunk ? cells->last_bit % CHUNK_BITS / 64 + 1 : CHUNK_WORDS;
+            uint64_t word = words[first_word] & (~(uint64_t) 0 << bit % 64);
+            for (size_t i = first_word; ; ) {
+                if (word != 0) {
+                    *current_bit = chunk * CHUNK_BITS + i * 64 + lowest_one_bit(word);
+                    return 0;
+                }
+                if (++i == end_word)
+                    break;
+                word = words[i];
+            }
+
+            if (bit % CHUNK_BITS == 0 && chunk != 0) {
+                free_chunk(words);
+                cells->chunks[chunk] = NULL;
+            }
+        }
+
+        if (chunk == last_chunk) {
+            bit = 0;
+            if (add_cell(cells))
+                return 1;
+        } else
+            bit = (chunk + 1) * CHUNK_BITS;
+    }
+}
+
+
+
+// Checkpoints
+
+// Set by SIGUSR1, or by SIGALRM every --checkpoint-interval seconds, asking run_program() to write a checkpoint the
+// next time it takes a branch
+volatile sig_atomic_t checkpoint_requested;
+
+#if defined(__unix__) || defined(__APPLE__)
+
+// Number of buffers passed to each call of writev(), the smallest limit allowed by POSIX
+#define CHECKPOINT_VECTORS 16
+
+#define CHECKPOINT_MAGIC "AXIOSCP2"
+
+// Start of a checkpoint file, followed by the characters of the input queue as UTF-32 and then the words of the cells
+// array, all in the byte order of the machine that wrote it
+struct checkpoint_header {
+    char magic[8];
+    uint64_t program_hash;  // Set by hash_program(), so that a checkpoint is only resumed by the program that wrote it
+    uint64_t state;         // State to run next
+    uint64_t current_bit;
+    uint64_t last_bit;
+    uint64_t output_bytes;  // Bytes of output written before the checkpoint
+    uint64_t input_bytes;   // Bytes of --batch or --input input added to the queue before the checkpoint
+    uint64_t queue_size;
+    uint32_t output_utf_32;
+    uint32_t toggle_output;
+    unsigned char current_input_bit;
+    unsigned char will_not_print_extra_line;
+    unsigned char padding[6];
+};
+
+void request_checkpoint(int signal_number) {
+    checkpoint_requested = 1;
+    if (signal_number == SIGALRM)
+        alarm(options.checkpoint_interval);
+}
+
+// Starts listening for SIGUSR1 and starts the timer chosen by --checkpoint-interval
+void start_checkpoints() {
+    if (options.checkpoint_file_name == NULL)
+        return;
+    checkpoint_requested = 0;
+    signal(SIGUSR1, request_checkpoint);
+    if (options.checkpoint_interval != 0) {
+        signal(SIGALRM, request_checkpoint);
+        alarm(options.checkpoint_interval);
+    }
+}
+
+void stop_checkpoints() {
+    if (options.checkpoint_file_name == NULL)
+        return;
+    alarm(0);
+    signal(SIGUSR1, SIG_DFL);
+    signal(SIGALRM, SIG_DFL);
+}
+
+// Returns a 64-bit FNV-1a hash of the superinstructions, including the state each one begins with
+uint64_t hash_program(struct instruction program[]) {
+    uint64_t hash = 0xCBF29CE484222325;
+    for (unsigned long i = 0; ; i++) {
+        uint32_t fields[7] = {
+            program[i].opcode, program[i].will_move_pointer, program[i].outputs, program[i].inputs,
+            program[i].count, program[i].target, program[i].first_state
+        };
+        for (int j = 0; j < 7; j++) {
+            hash ^= fields[j];
+            hash *= 0x100000001B3;
+        }
+        if (program[i].opcode == HALT)
+            return hash;
+    }
+}
+
+// Writes buffers to a file, continuing after writes that only wrote part of them
+// Returns 1 if the file could not be written
+int write_vectors(int file_descriptor, struct iovec vectors[], int count) {
+    while (count > 0) {
+        ssize_t written = writev(file_descriptor, vectors, count < CHECKPOINT_VECTORS ? count : CHECKPOINT_VECTORS);
+        if (written < 0) {
+            if (errno == EINTR)
+                continue;
+            return 1;
+        }
+        while (count > 0 && (size_t) written >= vectors->iov_len) {
+            written -= vectors->iov_len;
+            vectors++;
+            count--;
+        }
+        if (count > 0) {
+            vectors->iov_base = (char*) vectors->iov_base + written;
+            vectors->iov_len -= written;
+        }
+    }
+    return 0;
+}
+
+// Writes everything needed to continue a run to the file chosen by --checkpoint, where state is the next state to run
+// The cells array and input queue are written straight from memory with writev(), and the new checkpoint is written
+// beside the old one and only replaces it once complete, so a run that dies while writing still leaves a checkpoint
+// Returns 1 if the checkpoint could not be written
+int write_checkpoint(struct instruction program[], unsigned long state, struct cells *cells, size_t current_bit, struct io *io) {
+    checkpoint_requested = 0;
+    wait_for_output(io->output);
+
+    struct checkpoint_header header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, CHECKPOINT_MAGIC, 8);
+    header.program_hash = hash_program(program);
+    header.state = state;
+    header.current_bit = current_bit;
+    header.last_bit = cells->last_bit;
+    header.output_bytes = io->output->bytes_written;
+    header.input_bytes = io->input != NULL ? io->input->bytes_read - (io->input->end - io->input->start) : 0;
+    header.queue_size = io->queue.size;
+    header.output_utf_32 = io->output_utf_32;
+    header.toggle_output = io->toggle_output;
+    header.current_input_bit = io->queue.current_input_bit;
+    header.will_not_print_extra_line = io->will_not_print_extra_line;
+
+    // One buffer for the header, two for the input queue, which may wrap around its ring buffer, and one for each chunk
+    // Unallocated chunks are written from a chunk of zeroes, whose pages are never touched, so it takes no memory
+    size_t words = cells->last_bit / 64 + 1;
+    int count = 3 + (int) cells->number_of_chunks;
+    struct iovec *vectors = malloc(count * sizeof(struct iovec));
+    uint64_t *zero_chunk = allocate_chunk();
+    if (vectors == NULL || zero_chunk == NULL) {
+        fprintf(stderr, "Failed to allocate memory for checkpoint\n");
+        free(vectors);
+        if (zero_chunk != NULL)
+            free_chunk(zero_chunk);
+        return 1;
+    }
+    size_t queue_end = io->queue.front + io->queue.size;
+    size_t wrapped = queue_end > io->queue.capacity ? queue_end - io->queue.capacity : 0;
+    vectors[0] = (struct iovec) {&header, sizeof(header)};
+    vectors[1] = (struct iovec) {io->queue.characters + io->queue.front, (io->queue.size - wrapped) * sizeof(uint32_t)};
+    vectors[2] = (struct iovec) {io->queue.characters, wrapped * sizeof(uint32_t)};
+    for (size_t chunk = 0; chunk < cells->number_of_chunks; chunk++) {
+        size_t chunk_words = words - chunk * CHUNK_WORDS < CHUNK_WORDS ? words - chunk * CHUNK_WORDS : CHUNK_WORDS;
+        vectors[3 + chunk] = (struct iovec) {cells->chunks[chunk] != NULL ? cells->chunks[chunk] : zero_chunk, chunk_words * sizeof(uint64_t)};
+    }
+
+    char temporary_name[4096];
+    snprintf(temporary_name, sizeof(temporary_name), "%s.tmp", options.checkpoint_file_name);
+    int file_descriptor = open(temporary_name, O_WRONLY | O_CREAT | O_TRUNC, 0666);
+    int failed = file_descriptor < 0 || write_vectors(file_descriptor, vectors, count) || fsync(file_descriptor) != 0;
+    if (file_descriptor >= 0 && close(file_descriptor) != 0)
+        failed = 1;
+    if (!failed && rename(temporary_name, options.checkpoint_file_name) != 0)
+        failed = 1;
+    free(vectors);
+    free_chunk(zero_chunk);
+    if (failed) {
+        fprintf(stderr, "Failed to write checkpoint %s\n", options.checkpoint_file_name);
+        return 1;
+    }
+    return 0;
+}
+
+// Restores a run from the checkpoint chosen by --resume, setting the instruction to continue from and the pointer
+// Output written after the checkpoint is removed from the file chosen by --output, so that it is not repeated, and input
+// read before the checkpoint is skipped, so that it is not read again
+// Returns 1 if the checkpoint could not be read or was written by another program
+int read_checkpoint(struct instruction program[], unsigned long *instruction_index, struct cells *cells, size_t *current_bit, struct io *io) {
+    FILE *file = fopen(options.resume_file_name, "rb");
+    if (file == NULL) {
+        fprintf(stderr, "Failed to open file %s\n", options.resume_file_name);
+        return 1;
+    }
+
+    struct checkpoint_header header;
+    if (fread(&header, sizeof(header), 1, file) != 1 || memcmp(header.magic, CHECKPOINT_MAGIC, 8) != 0) {
+        fprintf(stderr, "%s is not a checkpoint\n", options.resume_file_name);
+        fclose(file);
+        return 1;
+    }
+    if (header.program_hash != hash_program(program) || header.current_bit > header.last_bit || header.current_input_bit > 20) {
+        fprintf(stderr, "Checkpoint %s was written by a different program\n", options.resume_file_name);
+        fclose(file);
+        return 1;
+    }
+
+    // Finds the superinstruction beginning with the state, which is always the first state of one
+    unsigned long index = 0;
+    while (program[index].first_state != header.state && program[index].opcode != HALT)
+        index++;
+    *instruction_index = index;
+
+    // Reads the input queue into the beginning of its ring buffer
+    clear_queue(&io->queue);
+    io->queue.front = 0;
+    if (reserve_inputs(&io->queue, header.queue_size)) {
+        fprintf(stderr, "Failed to allocate memory\n");
+        fclose(file);
+        return 1;
+    }
+    int failed = fread(io->queue.characters, sizeof(uint32_t), header.queue_size, file) != header.queue_size;
+    io->queue.size = header.queue_size;
+    io->queue.current_input_bit = header.current_input_bit;
+    io->output_utf_32 = header.output_utf_32;
+    io->toggle_output = header.toggle_output;
+    io->will_not_print_extra_line = header.will_not_print_extra_line;
+
+    // Adds the chunks of the cells array, then allocates each and reads it straight into place
+    while (!failed && cells->number_of_chunks * CHUNK_BITS <= header.last_bit) {
+        cells->last_bit = cells->number_of_chunks * CHUNK_BITS - 1;
+        if (add_cell(cells)) {
+            fprintf(stderr, "Failed to allocate memory\n");
+            fclose(file);
+            return 1;
+        }
+    }
+    cells->last_bit = header.last_bit;
+    *current_bit = header.current_bit;
+    size_t words = header.last_bit / 64 + 1;
+    for (size_t chunk = 0; !failed && chunk < cells->number_of_chunks; chunk++) {
+        size_t chunk_words = words - chunk * CHUNK_WORDS < CHUNK_WORDS ? words - chunk * CHUNK_WORDS : CHUNK_WORDS;
+        uint64_t *first_word = word_address(cells, chunk * CHUNK_WORDS);
+        if (first_word == NULL) {
+            fprintf(stderr, "Failed to allocate memory\n");
+            fclose(file);
+            return 1;
+        }
+        failed = fread(first_word, sizeof(uint64_t), chunk_words, file) != chunk_words;
+    }
+    fclose(file);
+    if (failed) {
+        fprintf(stderr, "Checkpoint %s is incomplete\n", options.resume_file_name);
+        return 1;
+    }
+
+    if (options.output_file_name != NULL) {
+        if (ftruncate(io->output->file_descriptor, header.output_bytes) != 0 || lseek(io->output->file_descriptor, 0, SEEK_END) < 0) {
+            fprintf(stderr, "Failed to restore file %s\n", options.output_file_name);
+            return 1;
+        }
+    }
+    io->output->bytes_written = header.output_bytes;
+
+    if (header.input_bytes != 0) {
+        if (io->input == NULL) {
+            fprintf(stderr, "Checkpoint %s was written while reading --batch or --input, and needs the same input to continue\n", options.resume_file_name);
+            return 1;
+        }
+        if (skip_input(io->input, header.input_bytes)) {
+            fprintf(stderr, "The input ends before the part read by checkpoint %s\n", options.resume_file_name);
+            return 1;
+        }
+    }
+    return 0;
+}
+
+#else
+
+void start_checkpoints() {}
+
+void stop_checkpoints() {}
+
+int write_checkpoint(struct instruction program[], unsigned long state, struct cells *cells, size_t current_bit, struct io *io) {
+    checkpoint_requested = 0;
+    return 1;
+}
+
+int read_checkpoint(struct instruction program[], unsigned long *instruction_index, struct cells *cells, size_t *current_bit, struct io *io) {
+    fprintf(stderr, "Checkpoints are only supported on Unix-like systems\n");
+    return 1;
+}
+
+#endif
+
+
+
+// Runs the program
+void run_program(struct instruction program[], struct io *io) {
+    // Initializes variables used for tracking the current instruction
+    unsigned long instruction_index = 0;
+
+    // Initializes the cells array, the array of bits on which Axios operates
+    struct cells cells;
+    if (initialize_cells(&cells)) {
+        fprintf(stderr, "Failed to allocate memory\n");
+        return;
+    }
+
+    // Initializes variables used for moving along the cells array
+    // The word containing the current cell is kept in current_word and only written back to the cells array
+    // when the pointer leaves it, or before the cells array is operated on as a whole
+    size_t current_bit = 0;
+    uint64_t *word_pointer = cells.chunks[0];
+    uint64_t current_word = 0;
+    uint64_t toggle_bit = 1;
+
+    // Continues from a checkpoint instead of the beginning if one was chosen by --resume
+    if (options.resume_file_name != NULL) {
+        if (read_checkpoint(program, &instruction_index, &cells, &current_bit, io)) {
+            free_cells(&cells);
+            return;
+        }
+        word_pointer = word_address(&cells, current_bit / 64);
+        current_word = *word_pointer;
+        toggle_bit = (uint64_t) 1 << current_bit % 64;
+    }
+    start_checkpoints();
+
+    // Loops through all instructions until the termination state is reached
+    // Every loop in a program takes a branch, so checkpoints are only written after taking one
+    while (program[instruction_index].opcode != HALT) {
+        struct instruction *instruction = &program[instruction_index];
+        switch (instruction->opcode) {
+            // Changes and moves past a run of cells, then goes to the next instruction
+            // ADVANCE_BRANCH continues as a branch afterwards
+            case ADVANCE:
+            case ADVANCE_BRANCH: {
+                *word_pointer = current_word;
+                if (advance_pointer(&cells, &current_bit, instruction->count)) {
+                    fprintf(stderr, "Failed to allocate memory\n");
+                    stop_checkpoints();
+                    free_cells(&cells);
+                    return;
+                }
+                word_pointer = word_address(&cells, current_bit / 64);
+                current_word = *word_pointer;
+                toggle_bit = (uint64_t) 1 << current_bit % 64;
+                if (instruction->opcode == ADVANCE) {
+                    instruction_index++;
+                    break;
+                }
+            } // Fall through
+
+            // If the current bit is one after changing it, go to the target instruction
+            // Otherwise, go to the next instruction
+            case BRANCH: {
+                current_word ^= toggle_bit;
+                if (current_word & toggle_bit) {
+                    instruction_index = instruction->target;
+                    if (checkpoint_requested) {
+                        *word_pointer = current_word;
+                        write_checkpoint(program, program[instruction_index].first_state, &cells, current_bit, io);
+                    }
+                } else
+                    instruction_index++;
+            } break;
+
+            // A zero cell changes to one and repeats the state, and a one cell changes to zero, so the cell always ends as zero
+            case CLEAR: {
+                current_word &= ~toggle_bit;
+                instruction_index++;
+            } break;
+
+            // Changes the current cell and moves the pointer forward, then moves past every zero cell until a one
+            // cell is found, which is changed to zero (the first state changes each zero cell back after the second)
+            case SCAN: {
+                *word_pointer = current_word;
+                if (advance_pointer(&cells, &current_bit, 1) || find_one(&cells, &current_bit)) {
+                    fprintf(stderr, "Failed to allocate memory\n");
+                    stop_checkpoints();
+                    free_cells(&cells);
+                    return;
+                }
+                word_pointer = word_address(&cells, current_bit / 64);
+                toggle_bit = (uint64_t) 1 << current_bit % 64;
+                current_word = *word_pointer ^ toggle_bit;
+                instruction_index++;
+            } break;
+
+            case GENERAL_STATE: {
+                if (instruction->inputs == 0)
+                    // Changes the current bit
+                    // Happens for all states unless user input is requested
+                    current_word ^= toggle_bit;
+                else {
+                    // Operates input queue, changing the current bit according to user input
+                    begin_io(io);
+                    int input_bit = read_input_bits(io, instruction->inputs);
+                    if (input_bit < 0) {
+                        stop_checkpoints();
+                        free_cells(&cells);
+                        return;
+                    }
+                    if (input_bit)
+                        current_word |= toggle_bit;
+                    else
+                        current_word &= ~toggle_bit;
+                }
+
+                // Outputs characters based on the number of 2 operators in the current state
+                for (unsigned char i = instruction->outputs; i > 0; i--)
+                    write_output_bit(io, (current_word & toggle_bit) != 0);
+
+                // If the current state has no 0 operators, shift the pointer forward
+                // If the last bit is reached, add a new bit and return to the beginning
+                // When this process is completed, go to the next state written in code
+                if (instruction->will_move_pointer) {
+                    if (current_bit != cells.last_bit) {
+                        current_bit++;
+                        toggle_bit <<= 1;
+                        if (toggle_bit == 0) {
+                            *word_pointer = current_word;
+                            if (current_bit % CHUNK_BITS != 0)
+                                word_pointer++;
+                            else if ((word_pointer = word_address(&cells, current_bit / 64)) == NULL) {
+                                fprintf(stderr, "Failed to allocate memory\n");
+                                stop_checkpoints();
+                                free_cells(&cells);
+                                return;
+                            }
+                            current_word = *word_pointer;
+                            toggle_bit = 1;
+                        }
+                    } else {
+                        // The word index and toggle bit for the first cell are set directly, rather than by walking back
+                        *word_pointer = current_word;
+                        if (add_cell(&cells)) {
+                            fprintf(stderr, "Failed to allocate memory\n");
+                            stop_checkpoints();
+                            free_cells(&cells);
+                            return;
+                        }
+                        current_bit = 0;
+                        word_pointer = cells.chunks[0];
+                        current_word = *word_pointer;
+                        toggle_bit = 1;
+                    }
+                    instruction_index++;
+                }
+                // If there are 0 operators and the current bit is one, go to the instruction marked by target
+                else if (current_word & toggle_bit) {
+                    instruction_index = instruction->target;
+                    if (checkpoint_requested) {
+                        *word_pointer = current_word;
+                        write_checkpoint(program, program[instruction_index].first_state, &cells, current_bit, io);
+                    }
+                }
+                // If there are 0 operators and the current bit is zero, go to the next state written in code
+                else
+                    instruction_index++;
+            } break;
+
+            case ENDLESS_LOOP: {
+                run_endless_loop(program, instruction->target, io);
+                stop_checkpoints();
+                free_cells(&cells);
+                return;
+            }
+        }
+    }
+
+    stop_checkpoints();
+    end_io(io);
+    free_cells(&cells);
+}
+
+
+
+// Threaded Code
+
+// Kinds of handlers each state is specialized into for run_threaded()
+enum handler_kind {
+    TOGGLE_MOVE,           // Changes the current cell and moves the pointer forward
+    TOGGLE_BRANCH,         // Changes the current cell and goes to the next state marked by next_state if it is one
+    TOGGLE_OUTPUT_MOVE,    // As TOGGLE_MOVE, outputting the current cell before moving
+    TOGGLE_OUTPUT_BRANCH,  // As TOGGLE_BRANCH, outputting the current cell before branching
+    INPUT_MOVE,            // Sets the current cell according to user input, outputs it if needed, and moves the pointer forward
+    INPUT_BRANCH,          // Sets the current cell according to user input, outputs it if needed, and branches
+    TERMINATE              // The termination state
+};
+
+// State struct used by run_threaded()
+struct threaded_state {
+    unsigned char handler;
+    unsigned char outputs;
+    unsigned char inputs;
+    uint32_t next_state;  // The state to go to if a branch is taken
+};
+
+// Specializes each state into the handler for its combination of operators
+void compile_threaded_states(struct state states[], unsigned long number_of_states, struct threaded_state threaded_states[]) {
+    for (unsigned long state = 0; state < number_of_states; state++) {
+        struct threaded_state *threaded_state = &threaded_states[state];
+        if (states[state].inputs != 0)
+            threaded_state->handler = states[state].will_move_pointer ? INPUT_MOVE : INPUT_BRANCH;
+        else if (states[state].outputs != 0)
+            threaded_state->handler = states[state].will_move_pointer ? TOGGLE_OUTPUT_MOVE : TOGGLE_OUTPUT_BRANCH;
+        else
+            threaded_state->handler = states[state].will_move_pointer ? TOGGLE_MOVE : TOGGLE_BRANCH;
+        threaded_state->outputs = states[state].outputs;
+        threaded_state->inputs = states[state].inputs;
+        threaded_state->next_state = states[state].will_move_pointer ? 0 : states[state].next_state;
+    }
+    threaded_states[number_of_states].handler = TERMINATE;
+}
+
+// Runs the program one state at a time, jumping directly from the end of each handler to the handler of the next state
+// Each handler therefore has its own indirect jump, and so its own history in the branch predictor
+// Compilers without computed goto use a switch statement instead
+void run_threaded(struct threaded_state states[], struct io *io) {
+    struct threaded_state *state = states;
+
+    // Initializes the cells array and the variables used for moving along it, as in run_program()
+    struct cells cells;
+    if (initialize_cells(&cells)) {
+        fprintf(stderr, "Failed to allocate memory\n");
+        return;
+    }
+    size_t current_bit = 0;
+    uint64_t *word_pointer = cells.chunks[0];
+    uint64_t current_word = 0;
+    uint64_t toggle_bit = 1;
+    int input_bit;  // Set by INPUT()
+
+// Moves the pointer forward, adding a new bit and returning to the beginning if the last bit is reached
+#define MOVE_POINTER() \
+    if (current_bit != cells.last_bit) { \
+        current_bit++; \
+        toggle_bit <<= 1; \
+        if (toggle_bit == 0) { \
+            *word_pointer = current_word; \
+            if (current_bit % CHUNK_BITS != 0) \
+                word_pointer++; \
+            else if ((word_pointer = word_address(&cells, current_bit / 64)) == NULL) \
+                goto out_of_memory; \
+            current_word = *word_pointer; \
+            toggle_bit = 1; \
+        } \
+    } else { \
+        *word_pointer = current_word; \
+        if (add_cell(&cells)) \
+            goto out_of_memory; \
+        current_bit = 0; \
+        word_pointer = cells.chunks[0]; \
+        current_word = *word_pointer; \
+        toggle_bit = 1; \
+    }
+
+// Goes to the state marked by next_state if the current bit is one, or else the next state written in code
+#define BRANCH() \
+    state = (current_word & toggle_bit) ? &states[state->next_state] : state + 1
+
+// Sets the current cell according to user input
+#define INPUT() \
+    begin_io(io); \
+    input_bit = read_input_bits(io, state->inputs); \
+    if (input_bit < 0) \
+        goto input_failed; \
+    if (input_bit) \
+        current_word |= toggle_bit; \
+    else \
+        current_word &= ~toggle_bit
+
+#define OUTPUT() \
+    for (unsigned char i = state->outputs; i > 0; i--) \
+        write_output_bit(io, (current_word & toggle_bit) != 0)
+
+#if defined(__GNUC__)
+#define HANDLER(kind) kind##_handler:
+#define DISPATCH() goto *handlers[state->handler]
+    static void *handlers[] = {
+        &&TOGGLE_MOVE_handler, &&TOGGLE_BRANCH_handler, &&TOGGLE_OUTPUT_MOVE_handler, &&TOGGLE_OUTPUT_BRANCH_handler,
+        &&INPUT_MOVE_handler, &&INPUT_BRANCH_handler, &&TERMINATE_handler
+    };
+    DISPATCH();
+    {
+#else
+#define HANDLER(kind) case kind:
+#define DISPATCH() goto dispatch
+    dispatch: switch (state->handler) {
+#endif
+        HANDLER(TOGGLE_MOVE)
+            current_word ^= toggle_bit;
+            MOVE_POINTER();
+            state++;
+            DISPATCH();
+
+        HANDLER(TOGGLE_BRANCH)
+            current_word ^= toggle_bit;
+            BRANCH();
+            DISPATCH();
+
+        HANDLER(TOGGLE_OUTPUT_MOVE)
+            current_word ^= toggle_bit;
+            OUTPUT();
+            MOVE_POINTER();
+            state++;
+            DISPATCH();
+
+        HANDLER(TOGGLE_OUTPUT_BRANCH)
+            current_word ^= toggle_bit;
+            OUTPUT();
+            BRANCH();
+            DISPATCH();
+
+        HANDLER(INPUT_MOVE)
+            INPUT();
+            OUTPUT();
+            MOVE_POINTER();
+            state++;
+            DISPATCH();
+
+        HANDLER(INPUT_BRANCH)
+            INPUT();
+            OUTPUT();
+            BRANCH();
+            DISPATCH();
+
+        HANDLER(TERMINATE)
+            end_io(io);
+            free_cells(&cells);
+            return;
+    }
+
+#undef MOVE_POINTER
+#undef BRANCH
+#undef INPUT
+#undef OUTPUT
+#undef HANDLER
+#undef DISPATCH
+
+out_of_memory:
+    fprintf(stderr, "Failed to allocate memory\n");
+input_failed:
+    free_cells(&cells);
+}
+
+
+
+// Memoization
+
+// Number of remembered blocks, which must be a power of two
+#ifndef MEMO_ENTRIES
+#define MEMO_ENTRIES 1048576
+#endif
+
+// Maximum number of states run in one block, so that a loop of states which never moves the pointer cannot stall
+// the filling of an entry
+#define MEMO_STEP_LIMIT 1024
+
+// The effect of running from a state with the pointer on one bit of a word, until the pointer leaves the word or a
+// state with I/O or the termination state is reached
+struct memo_entry {
+    uint64_t word;               // Word containing the current cell beforehand
+    uint64_t result_word;        // The same word afterwards
+    uint32_t state;              // State beforehand, plus one so that zero marks an empty entry
+    uint32_t result_state;       // State afterwards
+    unsigned char bit;           // Position of the current cell within the word beforehand
+    unsigned char result_bit;    // Position afterwards, or 64 if the pointer left the word
+};
+
+// Fills in the result of an entry by running its states one at a time
+// The word must not contain the last bit, so that the cells array never grows within a block
+void run_block(struct threaded_state states[], struct memo_entry *entry) {
+    unsigned long state = entry->state - 1;
+    uint64_t word = entry->word;
+    unsigned char bit = entry->bit;
+    for (unsigned int steps = 0; steps < MEMO_STEP_LIMIT; steps++) {
+        if (states[state].handler == TOGGLE_MOVE) {
+            word ^= (uint64_t) 1 << bit;
+            state++;
+            if (++bit == 64)
+                break;
+        } else if (states[state].handler == TOGGLE_BRANCH) {
+            word ^= (uint64_t) 1 << bit;
+            state = (word >> bit & 1) ? states[state].next_state : state + 1;
+        } else
+            break;
+    }
+    entry->result_word = word;
+    entry->result_state = state;
+    entry->result_bit = bit;
+}
+
+// Runs the program a block at a time, remembering the effect of each block in a table indexed by its state, word and
+// bit position, so that blocks seen before are skipped in one lookup
+// States with I/O, the termination state and the word containing the last bit are run one state at a time instead
+void run_memoized(struct threaded_state states[], struct io *io) {
+    unsigned long state = 0;
+
+    struct memo_entry *memo = calloc(MEMO_ENTRIES, sizeof(struct memo_entry));
+    if (memo == NULL) {
+        fprintf(stderr, "Failed to allocate memory\n");
+        return;
+    }
+
+    // Initializes the cells array and the variables used for moving along it, as in run_program()
+    struct cells cells;
+    if (initialize_cells(&cells)) {
+        fprintf(stderr, "Failed to allocate memory\n");
+        free(memo);
+        return;
+    }
+    size_t current_bit = 0;
+    uint64_t *word_pointer = cells.chunks[0];
+    uint64_t current_word = 0;
+    uint64_t toggle_bit = 1;
+
+    while (states[state].handler != TERMINATE) {
+        unsigned char handler = states[state].handler;
+        if ((handler == TOGGLE_MOVE || handler == TOGGLE_BRANCH) && current_bit / 64 != cells.last_bit / 64) {
+            // Finds the block in the table, running it if it is not there
+            unsigned char bit = current_bit % 64;
+            uint64_t hash = (current_word ^ (state + 1) * 0x9E3779B97F4A7C15u ^ bit) * 0xBF58476D1CE4E5B9u;
+            struct memo_entry *entry = &memo[(hash ^ hash >> 32) & (MEMO_ENTRIES - 1)];
+            if (entry->state != state + 1 || entry->word != current_word || entry->bit != bit) {
+                entry->state = state + 1;
+                entry->word = current_word;
+                entry->bit = bit;
+                run_block(states, entry);
+            }
+
+            current_word = entry->result_word;
+            state = entry->result_state;
+            if (entry->result_bit == 64) {
+                *word_pointer = current_word;
+                current_bit += 64 - bit;
+                if (current_bit % CHUNK_BITS != 0)
+                    word_pointer++;
+                else if ((word_pointer = word_address(&cells, current_bit / 64)) == NULL) {
+                    fprintf(stderr, "Failed to allocate memory\n");
+                    free_cells(&cells);
+                    free(memo);
+                    return;
+                }
+                current_word = *word_pointer;
+                toggle_bit = 1;
+            } else {
+                current_bit += entry->result_bit - bit;
+                toggle_bit = (uint64_t) 1 << entry->result_bit;
+            }
+            continue;
+        }
+
+        // Runs a single state, as in run_threaded()
+        if (states[state].inputs == 0)
+            current_word ^= toggle_bit;
+        else {
+            begin_io(io);
+            int input_bit = read_input_bits(io, states[state].inputs);
+            if (input_bit < 0) {
+                free_cells(&cells);
+                free(memo);
+                return;
+            }
+            if (input_bit)
+                current_word |= toggle_bit;
+            else
+                current_word &= ~toggle_bit;
+        }
+        for (unsigned char i = states[state].outputs; i > 0; i--)
+            write_output_bit(io, (current_word & toggle_bit) != 0);
+
+        if (handler == TOGGLE_MOVE || handler == TOGGLE_OUTPUT_MOVE || handler == INPUT_MOVE) {
+            if (current_bit != cells.last_bit) {
+                current_bit++;
+                toggle_bit <<= 1;
+                if (toggle_bit == 0) {
+                    *word_pointer = current_word;
+                    if (current_bit % CHUNK_BITS != 0)
+                        word_pointer++;
+                    else if ((word_pointer = word_address(&cells, current_bit / 64)) == NULL) {
+                        fprintf(stderr, "Failed to allocate memory\n");
+                        free_cells(&cells);
+                        free(memo);
+                        return;
+                    }
+                    current_word = *word_pointer;
+                    toggle_bit = 1;
+                }
+            } else {
+                *word_pointer = current_word;
+                if (add_cell(&cells)) {
+                    fprintf(stderr, "Failed to allocate memory\n");
+                    free_cells(&cells);
+                    free(memo);
+                    return;
+                }
+                current_bit = 0;
+                word_pointer = cells.chunks[0];
+                current_word = *word_pointer;
+                toggle_bit = 1;
+            }
+            state++;
+        } else
+            state = (current_word & toggle_bit) ? states[state].next_state : state + 1;
+    }
+
+    end_io(io);
+    free_cells(&cells);
+    free(memo);
+}
+
+
+
+// Profiling
+
+// Number of states listed in the summary printed after a profiled run
+#define PROFILE_REPORT_STATES 20
+
+// Counts kept for each state by run_profiled()
+struct state_profile {
+    uint64_t executions;
+    uint64_t branches_taken;      // Times a state with 0 operators went to the state marked by next_state
+    uint64_t tape_growths;        // Times a state moved the pointer from the last bit, adding a new bit
+    uint64_t characters_written;  // Times 21 bits of output were completed, whether printed or emptying the input queue
+    uint64_t input_requests;      // Times a state had to ask for more input
+};
+
+// Set when the user interrupts a profiled run, so that a program that never ends can still be profiled
+volatile sig_atomic_t profile_interrupted;
+
+// The signal number is never zero, so it marks the run as interrupted
+void interrupt_profile(int signal_number) {
+    profile_interrupted = signal_number;
+}
+
+// Runs the program one state at a time, adding to the counts of each state in profile
+// The other runners keep no counts, so profiling costs nothing unless --profile is chosen
+// Interrupting the program with Ctrl+C ends the run early instead of exiting, so the counts so far are still reported
+// Returns the length of the cells array when the program ended, which is also the longest it became
+size_t run_profiled(struct state states[], unsigned long number_of_states, struct state_profile profile[], struct io *io) {
+    struct cells cells;
+    if (initialize_cells(&cells)) {
+        fprintf(stderr, "Failed to allocate memory\n");
+        return 0;
+    }
+    size_t current_bit = 0;
+    uint64_t *word_pointer = cells.chunks[0];
+    uint64_t toggle_bit = 1;
+
+    profile_interrupted = 0;
+    signal(SIGINT, interrupt_profile);
+
+    unsigned long state = 0;
+    while (state != number_of_states && !profile_interrupted) {
+        struct state_profile *counts = &profile[state];
+        counts->executions++;
+
+        if (states[state].inputs == 0)
+            *word_pointer ^= toggle_bit;
+        else {
+            begin_io(io);
+            if (io->queue.size * 21 - io->queue.current_input_bit < states[state].inputs)
+                counts->input_requests++;
+            int input_bit = read_input_bits(io, states[state].inputs);
+            if (input_bit < 0)
+                break;
+            if (input_bit)
+                *word_pointer |= toggle_bit;
+            else
+                *word_pointer &= ~toggle_bit;
+        }
+
+        for (unsigned char i = states[state].outputs; i > 0; i--) {
+            write_output_bit(io, (*word_pointer & toggle_bit) != 0);
+            if (io->toggle_output == 0x00000001)
+                counts->characters_written++;
+        }
+
+        if (states[state].will_move_pointer) {
+            if (current_bit != cells.last_bit) {
+                current_bit++;
+                toggle_bit <<= 1;
+                if (toggle_bit == 0) {
+                    word_pointer = current_bit % CHUNK_BITS == 0 ? word_address(&cells, current_bit / 64) : word_pointer + 1;
+                    toggle_bit = 1;
+                    if (word_pointer == NULL) {
+                        fprintf(stderr, "Failed to allocate memory\n");
+                        break;
+                    }
+                }
+            } else {
+                if (add_cell(&cells)) {
+                    fprintf(stderr, "Failed to allocate memory\n");
+                    break;
+                }
+                counts->tape_growths++;
+                current_bit = 0;
+                word_pointer = cells.chunks[0];
+                toggle_bit = 1;
+            }
+            state++;
+        } else if (*word_pointer & toggle_bit) {
+            counts->branches_taken++;
+            state = states[state].next_state;
+        } else
+            state++;
+    }
+
+    // As in the other runners, a program that runs out of input or memory ends without the final newline
+    if (state == number_of_states)
+        end_io(io);
+    signal(SIGINT, SIG_DFL);
+    size_t tape_length = cells.last_bit + 1;
+    free_cells(&cells);
+    return tape_length;
+}
+
+// Prints a summary of the counts to standard error, including the states run most often, and writes the counts of every
+// state to file_name as CSV
+// Each state is listed with the byte offset in the code at which it begins, so that counts can be traced back to the code
+// Returns 1 if the file could not be written
+int write_profile(struct state states[], unsigned long number_of_states, struct state_profile profile[], size_t source_offsets[], size_t tape_length, char file_name[]) {
+    // Finds the states run most often, keeping them in order of executions
+    unsigned long hottest[PROFILE_REPORT_STATES];
+    unsigned long number_of_hottest = 0;
+    uint64_t steps = 0;
+    for (unsigned long state = 0; state < number_of_states; state++) {
+        uint64_t executions = profile[state].executions;
+        steps += executions;
+        if (executions == 0 || (number_of_hottest == PROFILE_REPORT_STATES && executions <= profile[hottest[number_of_hottest - 1]].executions))
+            continue;
+        unsigned long position = number_of_hottest < PROFILE_REPORT_STATES ? number_of_hottest++ : number_of_hottest - 1;
+        while (position > 0 && profile[hottest[position - 1]].executions < executions) {
+            hottest[position] = hottest[position - 1];
+            position--;
+        }
+        hottest[position] = state;
+    }
+
+    fprintf(stderr, "\nProfile: %llu steps, %lu states, cells array grew to %zu bits\n", (unsigned long long) steps, number_of_states, tape_length);
+    fprintf(stderr, "%10s %10s %20s %8s %12s %12s %12s\n", "state", "offset", "executions", "taken", "growths", "characters", "requests");
+    for (unsigned long i = 0; i < number_of_hottest; i++) {
+        // States that move the pointer never branch, so they have no ratio of branches taken
+        struct state_profile *counts = &profile[hottest[i]];
+        char taken[16] = "       -";
+        if (!states[hottest[i]].will_move_pointer)
+            snprintf(taken, sizeof(taken), "%7.1f%%", 100.0 * counts->branches_taken / counts->executions);
+        fprintf(stderr, "%10lu %10zu %20llu %s %12llu %12llu %12llu\n", hottest[i], source_offsets[hottest[i]],
+                (unsigned long long) counts->executions, taken, (unsigned long long) counts->tape_growths,
+                (unsigned long long) counts->characters_written, (unsigned long long) counts->input_requests);
+    }
+
+    FILE *file = fopen(file_name, "w");
+    if (file == NULL) {
+        fprintf(stderr, "Failed to open file %s\n", file_name);
+        return 1;
+    }
+    fprintf(file, "# steps=%llu,tape_length=%zu\n", (unsigned long long) steps, tape_length);
+    fprintf(file, "state,offset,executions,branches_taken,tape_growths,characters_written,input_requests\n");
+    for (unsigned long state = 0; state < number_of_states; state++) {
+        struct state_profile *counts = &profile[state];
+        fprintf(file, "%lu,%zu,%llu,%llu,%llu,%llu,%llu\n", state, source_offsets[state], (unsigned long long) counts->executions,
+                (unsigned long long) counts->branches_taken, (unsigned long long) counts->tape_growths,
+                (unsigned long long) counts->characters_written, (unsigned long long) counts->input_requests);
+    }
+    if (fclose(file) != 0) {
+        fprintf(stderr, "Failed to write file %s\n", file_name);
+        return 1;
+    }
+    return 0;
+}
+
+
+
+// Hardware Counters
+
+// Events counted by --counters
+enum counter {
+    CYCLES,
+    INSTRUCTIONS,
+    BRANCH_MISSES,
+    L1D_MISSES,   // Reads that missed the first level data cache
+    LLC_MISSES,   // References that missed the last level cache
+    PAGE_FAULTS,  // Counted by the kernel rather than the processor, so it shows the memory a run touches even where the
+                  // processor's counters are not available
+    NUMBER_OF_COUNTERS
+};
+
+const char *counter_names[NUMBER_OF_COUNTERS] = {"cycles", "instructions", "branch misses", "L1D misses", "LLC misses", "page faults"};
+
+// Counters started by start_counters(), each -1 if the system could not provide it
+struct counters {
+    int file_descriptors[NUMBER_OF_COUNTERS];
+};
+
+#if defined(__linux__)
+
+// Starts counting each event for the calling thread, in user space only so that no special permission is needed
+void start_counters(struct counters *counters) {
+    static const struct {
+        uint32_t type;
+        uint64_t config;
+    } events[NUMBER_OF_COUNTERS] = {
+        {PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES},
+        {PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS},
+        {PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES},
+        {PERF_TYPE_HW_CACHE, PERF_COUNT_HW_CACHE_L1D | PERF_COUNT_HW_CACHE_OP_READ << 8 | PERF_COUNT_HW_CACHE_RESULT_MISS << 16},
+        {PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES},
+        {PERF_TYPE_SOFTWARE, PERF_COUNT_SW_PAGE_FAULTS}
+    };
+    for (int i = 0; i < NUMBER_OF_COUNTERS; i++) {
+        struct perf_event_attr attributes;
+        memset(&attributes, 0, sizeof(attributes));
+        attributes.size = sizeof(attributes);
+        attributes.type = events[i].type;
+        attributes.config = events[i].config;
+        attributes.exclude_kernel = 1;
+        attributes.exclude_hv = 1;
+        attributes.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+        counters->file_descriptors[i] = syscall(SYS_perf_event_open, &attributes, 0, -1, -1, 0);
+    }
+}
+
+// Stops the counters and stores their counts in counts, or -1 for each counter that could not be started
+// The processor has only a few counters, so the kernel may take turns between events, in which case each count is
+// scaled up from the part of the time it was counted
+void stop_counters(struct counters *counters, int64_t counts[]) {
+    for (int i = 0; i < NUMBER_OF_COUNTERS; i++) {
+        uint64_t values[3];  // The count, the time enabled and the time counted
+        counts[i] = -1;
+        if (counters->file_descriptors[i] < 0)
+            continue;
+        if (read(counters->file_descriptors[i], values, sizeof(values)) == sizeof(values) && values[2] != 0)
+            counts[i] = values[2] == values[1] ? (int64_t) values[0] : (int64_t) ((double) values[0] * values[1] / values[2]);
+        close(counters->file_descriptors[i]);
+    }
+}
+
+#else
+
+void start_counters(struct counters *counters) {
+    for (int i = 0; i < NUMBER_OF_COUNTERS; i++)
+        counters->file_descriptors[i] = -1;
+}
+
+void stop_counters(struct counters *counters, int64_t counts[]) {
+    for (int i = 0; i < NUMBER_OF_COUNTERS; i++)
+        counts[i] = -1;
+}
+
+#endif
+
+// Prints the counts from parsing and from running a program to standard error, where parse_counts is NULL if the
+// program was not parsed, along with the instructions per cycle (IPC) of the run
+void print_counters(int64_t parse_counts[], int64_t run_counts[]) {
+    fprintf(stderr, "\nCounters %24s %20s\n", "parse", "run");
+    for (int i = 0; i < NUMBER_OF_COUNTERS; i++) {
+        char parse[24] = "-", run[24] = "-";
+        if (parse_counts != NULL && parse_counts[i] >= 0)
+            snprintf(parse, sizeof(parse), "%lld", (long long) parse_counts[i]);
+        if (run_counts[i] >= 0)
+            snprintf(run, sizeof(run), "%lld", (long long) run_counts[i]);
+        fprintf(stderr, "%-13s %19s %20s\n", counter_names[i], parse, run);
+    }
+    if (run_counts[CYCLES] > 0 && run_counts[INSTRUCTIONS] >= 0)
+        fprintf(stderr, "%-13s %19s %20.2f\n", "IPC", "", (double) run_counts[INSTRUCTIONS] / run_counts[CYCLES]);
+    if (run_counts[CYCLES] < 0)
+        fprintf(stderr, "The processor's counters are not available, as in many virtual machines, or are not allowed by perf_event_paranoid\n");
+}
+
+
+
+// Native Code
+
+// The program can be compiled into x86-64 machine code on Unix-like systems, which share the System V calling convention
+// Elsewhere, --jit falls back to run_program()
+#if defined(__x86_64__) && (defined(__unix__) || defined(__APPLE__))
+#define JIT_SUPPORTED
+#endif
+
+#if defined(JIT_SUPPORTED)
+
+// Machine state shared between native code and the C functions it calls
+// While native code runs, the word pointer, current bit, toggle bit and current word are kept in the registers rbx,
+// r12, r13 and r14, and they are only stored here (with the current word written back) before calling a C function
+struct jit_context {
+    struct cells cells;
+    struct io *io;
+    uint64_t *word_pointer;
+    size_t current_bit;
+    uint64_t toggle_bit;
+    uint32_t endless_loop;  // Index of the ENDLESS_LOOP instruction reached
+};
+
+// Sets the word pointer and toggle bit for the current bit after the cells array has been operated on as a whole
+void jit_find_current_word(struct jit_context *context) {
+    context->word_pointer = word_address(&context->cells, context->current_bit / 64);
+    context->toggle_bit = (uint64_t) 1 << context->current_bit % 64;
+}
+
+// Called by native code when the pointer moves past the last bit
+// Returns 1 if memory could not be allocated
+int jit_add_cell(struct jit_context *context) {
+    if (add_cell(&context->cells))
+        return 1;
+    context->current_bit = 0;
+    jit_find_current_word(context);
+    return 0;
+}
+
+// Called by native code when the pointer moves into a new chunk
+// Returns NULL if memory could not be allocated
+uint64_t* jit_word_address(struct jit_context *context, size_t current_bit) {
+    return word_address(&context->cells, current_bit / 64);
+}
+
+// Called by native code for ADVANCE instructions with long runs
+// Returns 1 if memory could not be allocated
+int jit_advance(struct jit_context *context, unsigned long count) {
+    if (advance_pointer(&context->cells, &context->current_bit, count))
+        return 1;
+    jit_find_current_word(context);
+    return 0;
+}
+
+// Called by native code for SCAN instructions
+// Returns 1 if memory could not be allocated
+int jit_scan(struct jit_context *context) {
+    if (advance_pointer(&context->cells, &context->current_bit, 1) || find_one(&context->cells, &context->current_bit))
+        return 1;
+    jit_find_current_word(context);
+    *context->word_pointer ^= context->toggle_bit;
+    return 0;
+}
+
+// Called by native code for the 2 and 3 operators of a GENERAL_STATE, after the current cell has been changed if needed
+// Returns 1 if the user's input could not be read
+int jit_input_output(struct jit_context *context, unsigned int inputs, unsigned int outputs) {
+    if (inputs != 0) {
+        begin_io(context->io);
+        int input_bit = read_input_bits(context->io, inputs);
+        if (input_bit < 0)
+            return 1;
+        if (input_bit)
+            *context->word_pointer |= context->toggle_bit;
+        else
+            *context->word_pointer &= ~context->toggle_bit;
+    }
+    for (unsigned char i = outputs; i > 0; i--)
+        write_output_bit(context->io, (*context->word_pointer & context->toggle_bit) != 0);
+    return 0;
+}
+
+// Buffer into which machine code is written
+struct code_buffer {
+    unsigned char *bytes;
+    size_t size;
+    size_t capacity;
+};
+
+// Statuses returned by compiled programs
+enum jit_status {
+    JIT_FINISHED,
+    JIT_OUT_OF_MEMORY,
+    JIT_INPUT_FAILED,
+    JIT_ENDLESS_LOOP  // The instruction reached is recorded in the context
+};
+
+void emit(struct code_buffer *code, const char *bytes, size_t length) {
+    memcpy(code->bytes + code->size, bytes, length);
+    code->size += length;
+}
+
+void emit_32(struct code_buffer *code, uint32_t value) {
+    memcpy(code->bytes + code->size, &value, 4);
+    code->size += 4;
+}
+
+void emit_64(struct code_buffer *code, uint64_t value) {
+    memcpy(code->bytes + code->size, &value, 8);
+    code->size += 8;
+}
+
+// Writes the displacement of a jump or call so it lands on target
+void patch_32(struct code_buffer *code, size_t position, size_t target) {
+    uint32_t displacement = (uint32_t) (target - (position + 4));
+    memcpy(code->bytes + position, &displacement, 4);
+}
+
+// Emits "call" to an absolute address through rax
+void emit_call(struct code_buffer *code, void *function) {
+    emit(code, "\x48\xB8", 2);  // mov rax, function
+    emit_64(code, (uint64_t) (uintptr_t) function);
+    emit(code, "\xFF\xD0", 2);  // call rax
+}
+
+// Emits a jump with a 32-bit displacement to a known position
+void emit_jump(struct code_buffer *code, const char *opcode, size_t opcode_length, size_t target) {
+    emit(code, opcode, opcode_length);
+    emit_32(code, 0);
+    patch_32(code, code->size - 4, target);
+}
+
+// Stores the registers holding the machine state in the context, writing back the current word
+void emit_store_state(struct code_buffer *code) {
+    emit(code, "\x49\x89\x9F", 3);  // mov [r15 + word_pointer], rbx
+    emit_32(code, offsetof(struct jit_context, word_pointer));
+    emit(code, "\x4D\x89\xA7", 3);  // mov [r15 + current_bit], r12
+    emit_32(code, offsetof(struct jit_context, current_bit));
+    emit(code, "\x4D\x89\xAF", 3);  // mov [r15 + toggle_bit], r13
+    emit_32(code, offsetof(struct jit_context, toggle_bit));
+    emit(code, "\x4C\x89\x33", 3);  // mov [rbx], r14
+}
+
+// Loads the registers holding the machine state from the context
+void emit_load_state(struct code_buffer *code) {
+    emit(code, "\x49\x8B\x9F", 3);  // mov rbx, [r15 + word_pointer]
+    emit_32(code, offsetof(struct jit_context, word_pointer));
+    emit(code, "\x4D\x8B\xA7", 3);  // mov r12, [r15 + current_bit]
+    emit_32(code, offsetof(struct jit_context, current_bit));
+    emit(code, "\x4D\x8B\xAF", 3);  // mov r13, [r15 + toggle_bit]
+    emit_32(code, offsetof(struct jit_context, toggle_bit));
+    emit(code, "\x4C\x8B\x33", 3);  // mov r14, [rbx]
+}
+
+// Emits a call to a C function taking the context, which returns a nonzero status if the program must stop
+void emit_checked_call(struct code_buffer *code, void *function, size_t exit_position) {
+    emit_store_state(code);
+    emit(code, "\x4C\x89\xFF", 3);  // mov rdi, r15
+    emit_call(code, function);
+    emit(code, "\x85\xC0", 2);      // test eax, eax
+    emit_jump(code, "\x0F\x85", 2, exit_position);  // jnz exit
+    emit_load_state(code);
+}
+
+// Emits code that moves the pointer forward, calling move_position when leaving the current word or passing the last bit
+void emit_move_pointer(struct code_buffer *code, size_t move_position) {
+    emit(code, "\x4D\x3B\xA7", 3);  // cmp r12, [r15 + last_bit]
+    emit_32(code, offsetof(struct jit_context, cells.last_bit));
+    emit(code, "\x74\x08", 2);      // je call
+    emit(code, "\x49\xFF\xC4", 3);  // inc r12
+    emit(code, "\x49\xD1\xE5", 3);  // shl r13, 1
+    emit(code, "\x75\x05", 2);      // jnz past call
+    emit_jump(code, "\xE8", 1, move_position);  // call move
+}
+
+// Compiles the superinstructions of a program into machine code
+// Returns 1 if memory could not be allocated
+int compile_native_code(struct instruction program[], unsigned long number_of_instructions, struct code_buffer *code) {
+    // Jumps within the code use 32-bit displacements, so larger programs are left to run_program()
+    code->capacity = 1024 + 256 * (size_t) number_of_instructions;
+    if (code->capacity > INT32_MAX)
+        return 1;
+    void *mapping = mmap(NULL, code->capacity, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    size_t *instruction_positions = malloc(number_of_instructions * sizeof(size_t));
+    size_t *branch_positions = malloc(number_of_instructions * sizeof(size_t));
+    if (mapping == MAP_FAILED || instruction_positions == NULL || branch_positions == NULL) {
+        if (mapping != MAP_FAILED)
+            munmap(mapping, code->capacity);
+        free(instruction_positions);
+        free(branch_positions);
+        return 1;
+    }
+    code->bytes = mapping;
+    code->size = 0;
+
+    // Entry: saves callee-saved registers, keeps the stack aligned for calls, and loads the machine state
+    emit(code, "\x53\x55\x41\x54\x41\x55\x41\x56\x41\x57", 10);  // push rbx, rbp, r12, r13, r14, r15
+    emit(code, "\x48\x83\xEC\x08", 4);  // sub rsp, 8
+    emit(code, "\x49\x89\xFF", 3);      // mov r15, rdi
+    emit_load_state(code);
+    size_t entry_jump = code->size + 1;
+    emit(code, "\xE9\x00\x00\x00\x00", 5);  // jmp to the first instruction
+
+    // Exits, returning a status in eax
+    size_t finished_position = code->size;
+    emit(code, "\x4C\x89\x33", 3);      // mov [rbx], r14
+    emit(code, "\x31\xC0", 2);          // xor eax, eax
+    size_t epilogue_jump = code->size + 1;
+    emit(code, "\xE9\x00\x00\x00\x00", 5);
+    size_t out_of_memory_position = code->size;
+    emit(code, "\xB8", 1);              // mov eax, JIT_OUT_OF_MEMORY
+    emit_32(code, JIT_OUT_OF_MEMORY);
+    size_t out_of_memory_jump = code->size + 1;
+    emit(code, "\xE9\x00\x00\x00\x00", 5);
+    size_t input_failed_position = code->size;
+    emit(code, "\xB8", 1);              // mov eax, JIT_INPUT_FAILED
+    emit_32(code, JIT_INPUT_FAILED);
+    size_t epilogue_position = code->size;
+    patch_32(code, epilogue_jump, epilogue_position);
+    patch_32(code, out_of_memory_jump, epilogue_position);
+    emit(code, "\x48\x83\xC4\x08", 4);  // add rsp, 8
+    emit(code, "\x41\x5F\x41\x5E\x41\x5D\x41\x5C\x5D\x5B", 10);  // pop r15, r14, r13, r12, rbp, rbx
+    emit(code, "\xC3", 1);              // ret
+
+    // Stub called when the pointer leaves the current word (r13 is zero) or passes the last bit (r13 is not)
+    size_t move_position = code->size;
+    emit(code, "\x4D\x85\xED", 3);      // test r13, r13
+    size_t wrap_jump = code->size + 1;
+    emit(code, "\x75\x00", 2);          // jnz wrap
+    emit(code, "\x4C\x89\x33", 3);      // mov [rbx], r14
+    emit(code, "\x48\x83\xC3\x08", 4);  // add rbx, 8
+    emit(code, "\x41\xBD\x01\x00\x00\x00", 6);  // mov r13d, 1
+    emit(code, "\x49\xF7\xC4", 3);      // test r12, CHUNK_BITS - 1
+    emit_32(code, CHUNK_BITS - 1);
+    size_t same_chunk_jump = code->size + 1;
+    emit(code, "\x75\x00", 2);          // jnz load
+    emit(code, "\x48\x83\xEC\x08", 4);  // sub rsp, 8
+    emit(code, "\x4C\x89\xFF", 3);      // mov rdi, r15
+    emit(code, "\x4C\x89\xE6", 3);      // mov rsi, r12
+    emit_call(code, (void*) jit_word_address);
+    emit(code, "\x48\x83\xC4\x08", 4);  // add rsp, 8
+    emit(code, "\x48\x85\xC0", 3);      // test rax, rax
+    size_t chunk_failed_jump = code->size + 1;
+    emit(code, "\x74\x00", 2);          // jz failed
+    emit(code, "\x48\x89\xC3", 3);      // mov rbx, rax
+    code->bytes[same_chunk_jump] = code->size - (same_chunk_jump + 1);
+    emit(code, "\x4C\x8B\x33", 3);      // load: mov r14, [rbx]
+    emit(code, "\xC3", 1);              // ret
+    code->bytes[wrap_jump] = code->size - (wrap_jump + 1);
+    emit_store_state(code);             // wrap:
+    emit(code, "\x48\x83\xEC\x08", 4);  // sub rsp, 8
+    emit(code, "\x4C\x89\xFF", 3);      // mov rdi, r15
+    emit_call(code, (void*) jit_add_cell);
+    emit(code, "\x48\x83\xC4\x08", 4);  // add rsp, 8
+    emit(code, "\x85\xC0", 2);          // test eax, eax
+    size_t failed_jump = code->size + 1;
+    emit(code, "\x75\x00", 2);          // jnz failed
+    emit_load_state(code);
+    emit(code, "\xC3", 1);              // ret
+    code->bytes[failed_jump] = code->size - (failed_jump + 1);
+    code->bytes[chunk_failed_jump] = code->size - (chunk_failed_jump + 1);
+    emit(code, "\x48\x83\xC4\x08", 4);  // failed: add rsp, 8, discarding the return address
+    emit_jump(code, "\xE9", 1, out_of_memory_position);
+
+    // Instructions, which fall through to the next instruction written in code
+    patch_32(code, entry_jump, code->size);
+    for (unsigned long i = 0; i < number_of_instructions; i++) {
+        struct instruction *instruction = &program[i];
+        instruction_positions[i] = code->size;
+        branch_positions[i] = 0;
+        switch (instruction->opcode) {
+            case ADVANCE:
+            case ADVANCE_BRANCH: {
+                if (instruction->count <= 4) {
+                    for (unsigned long j = 0; j < instruction->count; j++) {
+                        emit(code, "\x4D\x31\xEE", 3);  // xor r14, r13
+                        emit_move_pointer(code, move_position);
+                    }
+                } else {
+                    emit_store_state(code);
+                    emit(code, "\x4C\x89\xFF", 3);  // mov rdi, r15
+                    emit(code, "\x48\xBE", 2);      // mov rsi, count
+                    emit_64(code, instruction->count);
+                    emit_call(code, (void*) jit_advance);
+                    emit(code, "\x85\xC0", 2);      // test eax, eax
+                    emit_jump(code, "\x0F\x85", 2, out_of_memory_position);
+                    emit_load_state(code);
+                }
+                if (instruction->opcode == ADVANCE)
+                    break;
+            } // Fall through
+
+            case BRANCH: {
+                emit(code, "\x4D\x31\xEE", 3);  // xor r14, r13
+                emit(code, "\x4D\x85\xEE", 3);  // test r14, r13
+                emit(code, "\x0F\x85", 2);      // jnz target
+                branch_positions[i] = code->size;
+                emit_32(code, 0);
+            } break;
+
+            case CLEAR: {
+                emit(code, "\x4C\x89\xE8", 3);  // mov rax, r13
+                emit(code, "\x48\xF7\xD0", 3);  // not rax
+                emit(code, "\x49\x21\xC6", 3);  // and r14, rax
+            } break;
+
+            case SCAN: {
+                emit_checked_call(code, (void*) jit_scan, out_of_memory_position);
+            } break;
+
+            case GENERAL_STATE: {
+                if (instruction->inputs == 0)
+                    emit(code, "\x4D\x31\xEE", 3);  // xor r14, r13
+                emit_store_state(code);
+                emit(code, "\x4C\x89\xFF", 3);  // mov rdi, r15
+                emit(code, "\xBE", 1);          // mov esi, inputs
+                emit_32(code, instruction->inputs);
+                emit(code, "\xBA", 1);          // mov edx, outputs
+                emit_32(code, instruction->outputs);
+                emit_call(code, (void*) jit_input_output);
+                emit(code, "\x85\xC0", 2);      // test eax, eax
+                emit_jump(code, "\x0F\x85", 2, input_failed_position);
+                emit_load_state(code);
+                if (instruction->will_move_pointer)
+                    emit_move_pointer(code, move_position);
+                else {
+                    emit(code, "\x4D\x85\xEE", 3);  // test r14, r13
+                    emit(code, "\x0F\x85", 2);      // jnz target
+                    branch_positions[i] = code->size;
+                    emit_32(code, 0);
+                }
+            } break;
+
+            case HALT: {
+                emit_jump(code, "\xE9", 1, finished_position);
+            } break;
+
+            case ENDLESS_LOOP: {
+                emit(code, "\x41\xC7\x87", 3);  // mov dword [r15 + endless_loop], i
+                emit_32(code, offsetof(struct jit_context, endless_loop));
+                emit_32(code, i);
+                emit(code, "\xB8", 1);          // mov eax, JIT_ENDLESS_LOOP
+                emit_32(code, JIT_ENDLESS_LOOP);
+                emit_jump(code, "\xE9", 1, epilogue_position);
+            } break;
+        }
+    }
+
+    for (unsigned long i = 0; i < number_of_instructions; i++) {
+        if (branch_positions[i] != 0)
+            patch_32(code, branch_positions[i], instruction_positions[program[i].target]);
+    }
+    free(instruction_positions);
+    free(branch_positions);
+
+    if (mprotect(code->bytes, code->capacity, PROT_READ | PROT_EXEC) != 0) {
+        munmap(code->bytes, code->capacity);
+        return 1;
+    }
+    return 0;
+}
+
+// Compiles the program into machine code and runs it
+// Returns 1 if the program could not be started, in which case run_program() can run it instead
+int run_native_code(struct instruction program[], unsigned long number_of_instructions, struct io *io) {
+    struct code_buffer code;
+    if (compile_native_code(program, number_of_instructions, &code))
+        return 1;
+
+    struct jit_context context;
+    if (initialize_cells(&context.cells)) {
+        munmap(code.bytes, code.capacity);
+        return 1;
+    }
+    context.io = io;
+    context.current_bit = 0;
+    context.toggle_bit = 1;
+    context.word_pointer = context.cells.chunks[0];
+
+    int (*compiled_program)(struct jit_context*) = (int (*)(struct jit_context*)) (uintptr_t) code.bytes;
+    int status = compiled_program(&context);
+
+    if (status == JIT_OUT_OF_MEMORY)
+        fprintf(stderr, "Failed to allocate memory\n");
+    if (status == JIT_FINISHED)
+        end_io(io);
+    if (status == JIT_ENDLESS_LOOP)
+        run_endless_loop(program, program[context.endless_loop].target, io);
+    free_cells(&context.cells);
+    munmap(code.bytes, code.capacity);
+    return 0;
+}
+
+#endif
+
+
+
+// C Code
+
+// Beginning of every C program written by write_c_program(), up to the first state
+// The input queue, the output buffer and the input and output functions are copied from above so that output matches
+// run_program() exactly, while the cells array is a single array of 64-bit words that doubles in size when full
+const char c_program_start[] =
+    "// Compiled from an Axios program by axios.c\n"
+    "\n"
+    "#include <stdint.h>\n"
+    "#include <stdio.h>\n"
+    "#include <stdlib.h>\n"
+    "#include <string.h>\n"
+    "\n"
+    "#if defined(__unix__) || defined(__APPLE__)\n"
+    "#include <errno.h>\n"
+    "#include <fcntl.h>\n"
+    "#include <unistd.h>\n"
+    "#endif\n"
+    "\n"
+    "// Ways of deciding when buffered output is written, chosen by --flush\n"
+    "enum flush_policy {\n"
+    "    FLUSH_AUTOMATICALLY,  // FLUSH_ON_NEWLINE when writing to a terminal, or else FLUSH_ON_INPUT\n"
+    "    FLUSH_ON_NEWLINE,     // After every newline, and before input is read\n"
+    "    FLUSH_ON_INPUT,       // Before input is read\n"
+    "    FLUSH_ON_EXIT         // Only when the threshold is reached and when the program ends\n"
+    "};\n"
+    "\n"
+    "// Output is written as by axios.c without options\n"
+    "struct options {\n"
+    "    enum flush_policy flush_policy;\n"
+    "    size_t flush_threshold;\n"
+    "} options;\n"
+    "\n"
+    "// Queue of characters from user input, stored as UTF-32 encodings in a ring buffer that doubles in size when full\n"
+    "// Bits are read from the front character one at a time, so the queue also records how many of them have been read\n"
+    "struct input_queue {\n"
+    "    uint32_t *characters;\n"
+    "    size_t capacity;  // Always a power of two\n"
+    "    size_t front;     // Index of the front character\n"
+    "    size_t size;      // Number of characters, including the front character\n"
+    "    unsigned char current_input_bit;\n"
+    "};\n"
+    "\n"
+    "// Returns 1 if memory could not be allocated\n"
+    "int initialize_input_queue(struct input_queue *queue) {\n"
+    "    queue->capacity = 64;\n"
+    "    queue->characters = malloc(queue->capacity * sizeof(uint32_t));\n"
+    "    if (queue->characters == NULL)\n"
+    "        return 1;\n"
+    "    queue->front = 0;\n"
+    "    queue->size = 0;\n"
+    "    queue->current_input_bit = 0;\n"
+    "    return 0;\n"
+    "}\n"
+    "\n"
+    "void free_input_queue(struct input_queue *queue) {\n"
+    "    free(queue->characters);\n"
+    "}\n"
+    "\n"
+    "// Empties the queue\n"
+    "void clear_queue(struct input_queue *queue) {\n"
+    "    queue->size = 0;\n"
+    "    queue->current_input_bit = 0;\n"
+    "}\n"
+    "\n"
+    "// Adds a character to the back of the queue\n"
+    "// Returns 1 if memory could not be allocated\n"
+    "int add_input(struct input_queue *queue, uint32_t character) {\n"
+    "    if (queue->size == queue->capacity) {\n"
+    "        uint32_t *characters = realloc(queue->characters, queue->capacity * 2 * sizeof(uint32_t));\n"
+    "        if (characters == NULL)\n"
+    "            return 1;\n"
+    "\n"
+    "        // Characters that wrapped around to the beginning of the buffer are moved to follow the rest\n"
+    "        memcpy(characters + queue->capacity, characters, queue->front * sizeof(uint32_t));\n"
+    "        queue->characters = characters;\n"
+    "        queue->capacity *= 2;\n"
+    "    }\n"
+    "    queue->characters[(queue->front + queue->size) & (queue->capacity - 1)] = character;\n"
+    "    queue->size++;\n"
+    "    return 0;\n"
+    "}\n"
+    "\n"
+    "// Returns the next bit of the front character, removing the character once all 21 of its bits have been read\n"
+    "int remove_input_bit(struct input_queue *queue) {\n"
+    "    int bit = (queue->characters[queue->front] >> queue->current_input_bit) & 1;\n"
+    "    if (++queue->current_input_bit == 21) {\n"
+    "        queue->current_input_bit = 0;\n"
+    "        queue->front = (queue->front + 1) & (queue->capacity - 1);\n"
+    "        queue->size--;\n"
+    "    }\n"
+    "    return bit;\n"
+    "}\n"
+    "\n"
+    "// Reads a line of user input and adds its characters to the queue, ending with a newline\n"
+    "// A last line without a newline is given one\n"
+    "// Returns 1 if there is no more input, the input is not valid UTF-8 or memory could not be allocated\n"
+    "int add_inputs(struct input_queue *queue, FILE *file) {\n"
+    "    int c = getc(file);\n"
+    "    if (c == EOF)\n"
+    "        return 1;\n"
+    "\n"
+    "    while (c != '\\n' && c != EOF) {\n"
+    "        // Finds the number of continuation bytes following the first byte of the character\n"
+    "        uint32_t input_utf_32;\n"
+    "        int continuation_bytes;\n"
+    "        if (c > 0xEF && c < 0xF8) {\n"
+    "            input_utf_32 = c - 0xF0;\n"
+    "            continuation_bytes = 3;\n"
+    "        } else if (c > 0xDF && c < 0xF0) {\n"
+    "            input_utf_32 = c - 0xE0;\n"
+    "            continuation_bytes = 2;\n"
+    "        } else if (c > 0xBF && c < 0xE0) {\n"
+    "            input_utf_32 = c - 0xC0;\n"
+    "            continuation_bytes = 1;\n"
+    "        } else if (c < 0x80) {\n"
+    "            input_utf_32 = c;\n"
+    "            continuation_bytes = 0;\n"
+    "        } else {\n"
+    "            fprintf(stderr, \"\\nInvalid UTF-8 encoding input, cannot convert to UTF-32\\n\");\n"
+    "            return 1;\n"
+    "        }\n"
+    "\n"
+    "        for (int i = 0; i < continuation_bytes; i++) {\n"
+    "            c = getc(file);\n"
+    "            if (c < 0x80 || c > 0xBF) {\n"
+    "                fprintf(stderr, \"\\nInvalid UTF-8 encoding input, cannot convert to UTF-32\\n\");\n"
+    "                return 1;\n"
+    "            }\n"
+    "            input_utf_32 = input_utf_32 * 0x40 + c - 0x80;\n"
+    "        }\n"
+    "\n"
+    "        if (add_input(queue, input_utf_32)) {\n"
+    "            fprintf(stderr, \"\\nFailed to allocate memory\\n\");\n"
+    "            return 1;\n"
+    "        }\n"
+    "        c = getc(file);\n"
+    "    }\n"
+    "\n"
+    "    if (add_input(queue, '\\n')) {\n"
+    "        fprintf(stderr, \"\\nFailed to allocate memory\\n\");\n"
+    "        return 1;\n"
+    "    }\n"
+    "    return 0;\n"
+    "}\n"
+    "\n"
+    "// Size of the output buffer, unless a larger threshold is chosen with --flush\n"
+    "#define OUTPUT_BUFFER_SIZE 65536\n"
+    "\n"
+    "// Buffer holding UTF-8 output until it is written in one call\n"
+    "// Output goes to standard output, or to the file chosen by --output\n"
+    "struct output {\n"
+    "    unsigned char *buffer;\n"
+    "    size_t size;\n"
+    "    size_t threshold;  // Number of bytes at which the buffer is written\n"
+    "    enum flush_policy flush_policy;\n"
+    "#if defined(__unix__) || defined(__APPLE__)\n"
+    "    int file_descriptor;\n"
+    "#else\n"
+    "    FILE *file;\n"
+    "#endif\n"
+    "} output;\n"
+    "\n"
+    "// Opens the file chosen by --output, or standard output if there is none, for every program run\n"
+    "// Returns 1 if the file could not be opened\n"
+    "int open_output(char file_name[]) {\n"
+    "#if defined(__unix__) || defined(__APPLE__)\n"
+    "    output.file_descriptor = file_name == NULL ? STDOUT_FILENO : open(file_name, O_WRONLY | O_CREAT | O_TRUNC, 0666);\n"
+    "    if (output.file_descriptor < 0) {\n"
+    "#else\n"
+    "    output.file = file_name == NULL ? stdout : fopen(file_name, \"wb\");\n"
+    "    if (output.file == NULL) {\n"
+    "#endif\n"
+    "        fprintf(stderr, \"Failed to open file %s\\n\", file_name);\n"
+    "        return 1;\n"
+    "    }\n"
+    "    return 0;\n"
+    "}\n"
+    "\n"
+    "// Prepares the output buffer before a program runs\n"
+    "// Returns 1 if memory could not be allocated\n"
+    "int start_output(enum flush_policy flush_policy, size_t threshold) {\n"
+    "    output.threshold = threshold == 0 ? OUTPUT_BUFFER_SIZE : threshold;\n"
+    "    output.buffer = malloc(output.threshold + 4);\n"
+    "    if (output.buffer == NULL)\n"
+    "        return 1;\n"
+    "    output.size = 0;\n"
+    "\n"
+    "    // Standard output is line-buffered on a terminal, so the same is done here unless another policy is chosen\n"
+    "    output.flush_policy = flush_policy;\n"
+    "    if (flush_policy == FLUSH_AUTOMATICALLY) {\n"
+    "#if defined(__unix__) || defined(__APPLE__)\n"
+    "        output.flush_policy = isatty(output.file_descriptor) ? FLUSH_ON_NEWLINE : FLUSH_ON_INPUT;\n"
+    "#else\n"
+    "        output.flush_policy = output.file == stdout ? FLUSH_ON_NEWLINE : FLUSH_ON_INPUT;\n"
+    "#endif\n"
+    "    }\n"
+    "\n"
+    "    // Text printed before the program, such as the menu, must appear before its output\n"
+    "    fflush(stdout);\n"
+    "    return 0;\n"
+    "}\n"
+    "\n"
+    "// Writes all buffered output\n"
+    "void flush_output() {\n"
+    "#if defined(__unix__) || defined(__APPLE__)\n"
+    "    size_t written = 0;\n"
+    "    while (written < output.size) {\n"
+    "        ssize_t result = write(output.file_descriptor, output.buffer + written, output.size - written);\n"
+    "        if (result < 0) {\n"
+    "            if (errno == EINTR)\n"
+    "                continue;\n"
+    "            break;\n"
+    "        }\n"
+    "        written += result;\n"
+    "    }\n"
+    "#else\n"
+    "    fwrite(output.buffer, 1, output.size, output.file);\n"
+    "    fflush(output.file);\n"
+    "#endif\n"
+    "    output.size = 0;\n"
+    "}\n"
+    "\n"
+    "// Writes all buffered output and frees the buffer after a program ends\n"
+    "void finish_output() {\n"
+    "    flush_output();\n"
+    "    free(output.buffer);\n"
+    "}\n"
+    "\n"
+    "// Converts UTF-32 encoding to UTF-8 and adds it to the output\n"
+    "// As when printing it as a string, the null character adds nothing\n"
+    "void display_output(unsigned long output_utf_32) {\n"
+    "    unsigned char *output_string = output.buffer + output.size;\n"
+    "    if (output_utf_32 > 0xFFFF) {\n"
+    "        output_string[3] = 0x80 + output_utf_32 % 0x40;\n"
+    "        output_string[2] = 0x80 + output_utf_32 % 0x1000 / 0x40;\n"
+    "        output_string[1] = 0x80 + output_utf_32 % 0x40000 / 0x1000;\n"
+    "        output_string[0] = 0xF0 + output_utf_32 / 0x40000;\n"
+    "        output.size += 4;\n"
+    "    } else if (output_utf_32 > 0x7FF) {\n"
+    "        output_string[2] = 0x80 + output_utf_32 % 0x40;\n"
+    "        output_string[1] = 0x80 + output_utf_32 % 0x1000 / 0x40;\n"
+    "        output_string[0] = 0xE0 + output_utf_32 / 0x1000;\n"
+    "        output.size += 3;\n"
+    "    } else if (output_utf_32 > 0x7F) {\n"
+    "        output_string[1] = 0x80 + output_utf_32 % 0x40;\n"
+    "        output_string[0] = 0xC0 + output_utf_32 / 0x40;\n"
+    "        output.size += 2;\n"
+    "    } else if (output_utf_32 != 0) {\n"
+    "        output_string[0] = output_utf_32;\n"
+    "        output.size++;\n"
+    "    }\n"
+    "\n"
+    "    if (output.size >= output.threshold || (output_utf_32 == '\\n' && output.flush_policy == FLUSH_ON_NEWLINE))\n"
+    "        flush_output();\n"
+    "}\n"
+    "\n"
+    "// Struct holding the variables used for input and output while a program runs\n"
+    "struct io {\n"
+    "    struct input_queue queue;\n"
+    "    unsigned long output_utf_32;\n"
+    "    unsigned long toggle_output;\n"
+    "    unsigned char will_not_print_extra_line;\n"
+    "};\n"
+    "\n"
+    "// Initializes variables used for input and output, along with the input queue\n"
+    "// Returns 1 if memory could not be allocated\n"
+    "int initialize_io(struct io *io) {\n"
+    "    if (start_output(options.flush_policy, options.flush_threshold))\n"
+    "        return 1;\n"
+    "    if (initialize_input_queue(&io->queue)) {\n"
+    "        finish_output();\n"
+    "        return 1;\n"
+    "    }\n"
+    "    io->output_utf_32 = 0;\n"
+    "    io->toggle_output = 0x00000001;\n"
+    "    io->will_not_print_extra_line = 255;\n"
+    "    return 0;\n"
+    "}\n"
+    "\n"
+    "// Frees the input queue and writes any output still buffered\n"
+    "void free_io(struct io *io) {\n"
+    "    free_input_queue(&io->queue);\n"
+    "    finish_output();\n"
+    "}\n"
+    "\n"
+    "// Prints a newline before a program's first input or output, separating it from the command that ran the program\n"
+    "void begin_io(struct io *io) {\n"
+    "    if (io->will_not_print_extra_line) {\n"
+    "        display_output('\\n');\n"
+    "        io->will_not_print_extra_line = 0;\n"
+    "    }\n"
+    "}\n"
+    "\n"
+    "// Prints a newline after a program's last input or output, if there was any\n"
+    "void end_io(struct io *io) {\n"
+    "    if (!io->will_not_print_extra_line)\n"
+    "        display_output('\\n');\n"
+    "}\n"
+    "\n"
+    "// Returns the next bit from the input queue, where remaining_inputs is the number of 3 operators left in the current state\n"
+    "// Asks for user input when fewer bits than that are left unread in the queue\n"
+    "// Returns -1 if the user's input could not be read\n"
+    "int read_input_bit(struct io *io, unsigned char remaining_inputs) {\n"
+    "    while (io->queue.size * 21 - io->queue.current_input_bit < remaining_inputs) {\n"
+    "        if (output.flush_policy != FLUSH_ON_EXIT)\n"
+    "            flush_output();\n"
+    "        if (add_inputs(&io->queue, stdin))\n"
+    "            return -1;\n"
+    "    }\n"
+    "    return remove_input_bit(&io->queue);\n"
+    "}\n"
+    "\n"
+    "// Adds a bit to the output, displaying a character each time 21 bits form a valid UTF-32 encoding\n"
+    "// 21 ones empties the input queue instead\n"
+    "void write_output_bit(struct io *io, int bit) {\n"
+    "    if (bit)\n"
+    "        io->output_utf_32 ^= io->toggle_output;\n"
+    "    if (io->toggle_output != 0x00100000)\n"
+    "        io->toggle_output <<= 1;\n"
+    "    else {\n"
+    "        io->toggle_output = 0x00000001;\n"
+    "        if (io->output_utf_32 != 0x1FFFFF) {\n"
+    "            begin_io(io);\n"
+    "            display_output(io->output_utf_32);\n"
+    "        } else\n"
+    "            clear_queue(&io->queue);\n"
+    "        io->output_utf_32 = 0;\n"
+    "    }\n"
+    "}\n"
+    "\n"
+    "// The cells array, stored as 64-bit words with the first cell in the lowest bit of the first word\n"
+    "struct cells {\n"
+    "    uint64_t *words;\n"
+    "    size_t last_bit;\n"
+    "    size_t capacity;  // Number of bits allocated\n"
+    "};\n"
+    "\n"
+    "// Adds a new bit to the end of the cells array, doubling the array when it is full\n"
+    "// Returns 1 if memory could not be allocated\n"
+    "int add_cell(struct cells *cells) {\n"
+    "    if (++cells->last_bit == cells->capacity) {\n"
+    "        uint64_t *words = realloc(cells->words, cells->capacity / 32 * sizeof(uint64_t));\n"
+    "        if (words == NULL)\n"
+    "            return 1;\n"
+    "        memset(words + cells->capacity / 64, 0, cells->capacity / 64 * sizeof(uint64_t));\n"
+    "        cells->words = words;\n"
+    "        cells->capacity *= 2;\n"
+    "    }\n"
+    "    return 0;\n"
+    "}\n"
+    "\n"
+    "// Operations on the current cell, used by each state\n"
+    "#define CELL() (cells.words[current_bit / 64] >> current_bit % 64 & 1)\n"
+    "#define TOGGLE() cells.words[current_bit / 64] ^= (uint64_t) 1 << current_bit % 64\n"
+    "#define INPUT(remaining_inputs) { \\\n"
+    "    int input_bit = read_input_bit(&io, remaining_inputs); \\\n"
+    "    if (input_bit < 0) \\\n"
+    "        goto input_failed; \\\n"
+    "    cells.words[current_bit / 64] = (cells.words[current_bit / 64] & ~((uint64_t) 1 << current_bit % 64)) | (uint64_t) input_bit << current_bit % 64; \\\n"
+    "}\n"
+    "#define OUTPUT() write_output_bit(&io, CELL())\n"
+    "#define MOVE_POINTER() \\\n"
+    "    if (current_bit != cells.last_bit) \\\n"
+    "        current_bit++; \\\n"
+    "    else { \\\n"
+    "        current_bit = 0; \\\n"
+    "        if (add_cell(&cells)) \\\n"
+    "            goto out_of_memory; \\\n"
+    "    }\n"
+    "\n"
+    "int main() {\n"
+    "    size_t current_bit = 0;\n"
+    "    struct cells cells;\n"
+    "    cells.last_bit = 0;\n"
+    "    cells.capacity = 256;\n"
+    "    cells.words = calloc(cells.capacity / 64, sizeof(uint64_t));\n"
+    "    struct io io;\n"
+    "    if (open_output(NULL))\n"
+    "        return 1;\n"
+    "    if (cells.words == NULL || initialize_io(&io)) {\n"
+    "        fprintf(stderr, \"Failed to allocate memory\\n\");\n"
+    "        return 1;\n"
+    "    }\n";
+
+// Writes the program as a standalone C program, in which each state is a label and each branch a goto
+// Returns 1 if the file could not be written
+int write_c_program(struct state states[], unsigned long number_of_states, char file_name[]) {
+    unsigned char *is_target = calloc(number_of_states + 1, sizeof(unsigned char));
+    if (is_target == NULL) {
+        fprintf(stderr, "Failed to allocate memory\n");
+        return 1;
+    }
+    unsigned char has_inputs = 0;
+    unsigned char has_moves = 0;
+    for (unsigned long state = 0; state < number_of_states; state++) {
+        if (!states[state].will_move_pointer)
+            is_target[states[state].next_state] = 255;
+        else
+            has_moves = 255;
+        if (states[state].inputs != 0)
+            has_inputs = 255;
+    }
+
+    FILE *file = fopen(file_name, "w");
+    if (file == NULL) {
+        fprintf(stderr, "Failed to open file %s\n", file_name);
+        free(is_target);
+        return 1;
+    }
+
+    fputs(c_program_start, file);
+    for (unsigned long state = 0; state < number_of_states; state++) {
+        if (is_target[state])
+            fprintf(file, "state_%lu:\n", state);
+        if (states[state].inputs == 0)
+            fputs("    TOGGLE();\n", file);
+        else {
+            fputs("    begin_io(&io);\n", file);
+            for (unsigned char i = states[state].inputs; i > 0; i--)
+                fprintf(file, "    INPUT(%u)\n", i);
+        }
+        for (unsigned char i = states[state].outputs; i > 0; i--)
+            fputs("    OUTPUT();\n", file);
+        if (states[state].will_move_pointer)
+            fputs("    MOVE_POINTER();\n", file);
+        else
+            fprintf(file, "    if (CELL())\n        goto state_%lu;\n", (unsigned long) states[state].next_state);
+    }
+
+    // The termination state, followed by the ways a program can stop early
+    if (is_target[number_of_states])
+        fprintf(file, "state_%lu:\n", number_of_states);
+    fputs("    end_io(&io);\n    free_io(&io);\n    return 0;\n", file);
+    if (has_inputs)
+        fputs("\ninput_failed:\n    free_io(&io);\n    return 1;\n", file);
+    if (has_moves)
+        fputs("\nout_of_memory:\n    fprintf(stderr, \"Failed to allocate memory\\n\");\n    free_io(&io);\n    return 1;\n", file);
+    fputs("}\n", file);
+
+    free(is_target);
+    if (fclose(file) != 0) {
+        fprintf(stderr, "Failed to write file %s\n", file_name);
+        return 1;
+    }
+    return 0;
+}
+
+
+
+// Parse Code
 
 // Deterimines the operator associated with a three-byte character
 unsigned char identify_three_byte_operator(char string[], size_t index) {
@@ -319,325 +3653,2053 @@ unsigned char identify_three_byte_operator(char string[], size_t index) {
                         case '\xA9': return '3';
                 }} break;
 
-                // Bengali numerals
-                case '\xA7': {
-                    switch(string[index+2]) {
-                        case '\xA6': return '0';
-                        case '\xA7': return '1';
-                        case '\xA8': return '2';
-                        case '\xA9': return '3';
-                }} break;
+                // Bengali numerals
+                case '\xA7': {
+                    switch(string[index+2]) {
+                        case '\xA6': return '0';
+                        case '\xA7': return '1';
+                        case '\xA8': return '2';
+                        case '\xA9': return '3';
+                }} break;
+
+                // Tamil numerals
+                case '\xAF': {
+                    switch(string[index+2]) {
+                        case '\xA6': return '0';
+                        case '\xA7': return '1';
+                        case '\xA8': return '2';
+                        case '\xA9': return '3';
+                }} break;
+
+                // Thai numerals
+                case '\xB9': {
+                    switch(string[index+2]) {
+                        case '\x90': return '0';
+                        case '\x91': return '1';
+                        case '\x92': return '2';
+                        case '\x93': return '3';
+                }} break;
+
+                // Lao numerals
+                case '\xBB': {
+                    switch(string[index+2]) {
+                        case '\x90': return '0';
+                        case '\x91': return '1';
+                        case '\x92': return '2';
+                        case '\x93': return '3';
+                }} break;
+
+                // Tibetan numerals
+                case '\xBC': {
+                    switch(string[index+2]) {
+                        case '\xA0': return '0';
+                        case '\xA1': return '1';
+                        case '\xA2': return '2';
+                        case '\xA3': return '3';
+                }} break;
+        }} break;
+
+        case '\xE1': {
+            switch (string[index+1]) {
+                // Burmese numerals
+                case '\x81': {
+                    switch (string[index+2]) {
+                        case '\x80': return '0';
+                        case '\x81': return '1';
+                        case '\x82': return '2';
+                        case '\x83': return '3';
+                }} break;
+
+                // Khmer numerals
+                case '\x9F': {
+                    switch (string[index+2]) {
+                        case '\xA0': return '0';
+                        case '\xA1': return '1';
+                        case '\xA2': return '2';
+                        case '\xA3': return '3';
+                }} break;
+        }} break;
+
+        // Fullwidth numerals
+        case '\xEF': {
+            if (string[index+1] == '\xBC') {
+                switch (string[index+2]) {
+                    case '\x90': return '0';
+                    case '\x91': return '1';
+                    case '\x92': return '2';
+                    case '\x93': return '3';
+        }}} break;
+    }
+
+    return 'N';
+}
+
+// Deterimines the operator associated with a two-byte character
+unsigned char identify_two_byte_operator(char string[], size_t index) {
+    switch (string[index]) {
+        // Eastern Arabic numerals
+        case '\xD9': {
+            switch (string[index+1]) {
+                case '\xA0': return '0';
+                case '\xA1': return '1';
+                case '\xA2': return '2';
+                case '\xA3': return '3';
+            }
+        } break;
+
+        // Persian numerals
+        case '\xDB': {
+            switch (string[index+1]) {
+                case '\xB0': return '0';
+                case '\xB1': return '1';
+                case '\xB2': return '2';
+                case '\xB3': return '3';
+            }
+        } break;
+    }
+
+    return 'N';
+}
+
+// Returns the index of the first byte from index onwards that can change how the code is parsed: a null character, an
+// ASCII operator or the first byte of a multi-byte character
+// parse_program() moves past any other byte one at a time without effect, so runs of them, such as comments, are
+// skipped here 32 or 16 bytes at a time where vector instructions are available
+size_t skip_to_operator(char code[], size_t index) {
+#if defined(__AVX2__) || defined(__SSE2__)
+    // Loads are aligned, so they never cross into another page even where they read past the null character ending the code
+#if defined(__AVX2__)
+#define VECTOR_SIZE 32
+    const __m256i digit_bits = _mm256_set1_epi8((char) 0xFC), digits = _mm256_set1_epi8('0');
+    const __m256i lead_bits = _mm256_set1_epi8((char) 0xC0), zero = _mm256_setzero_si256();
+#else
+#define VECTOR_SIZE 16
+    const __m128i digit_bits = _mm_set1_epi8((char) 0xFC), digits = _mm_set1_epi8('0');
+    const __m128i lead_bits = _mm_set1_epi8((char) 0xC0), zero = _mm_setzero_si128();
+#endif
+    unsigned int offset = (uintptr_t) (code + index) % VECTOR_SIZE;
+    char *block = code + index - offset;
+    while (1) {
+        // Marks bytes from 0x30 to 0x33, bytes from 0xC0 upwards and null characters
+#if defined(__AVX2__)
+        __m256i bytes = _mm256_load_si256((__m256i*) block);
+        __m256i matches = _mm256_or_si256(_mm256_cmpeq_epi8(_mm256_and_si256(bytes, digit_bits), digits), _mm256_cmpeq_epi8(bytes, zero));
+        matches = _mm256_or_si256(matches, _mm256_cmpeq_epi8(_mm256_and_si256(bytes, lead_bits), lead_bits));
+        uint32_t mask = (uint32_t) _mm256_movemask_epi8(matches);
+#else
+        __m128i bytes = _mm_load_si128((__m128i*) block);
+        __m128i matches = _mm_or_si128(_mm_cmpeq_epi8(_mm_and_si128(bytes, digit_bits), digits), _mm_cmpeq_epi8(bytes, zero));
+        matches = _mm_or_si128(matches, _mm_cmpeq_epi8(_mm_and_si128(bytes, lead_bits), lead_bits));
+        uint32_t mask = (uint32_t) _mm_movemask_epi8(matches);
+#endif
+        mask &= ~(uint32_t) 0 << offset;
+        if (mask != 0)
+            return block - code + lowest_one_bit(mask);
+        block += VECTOR_SIZE;
+        offset = 0;
+    }
+#undef VECTOR_SIZE
+#else
+    unsigned char c = code[index];
+    while (c != '\0' && (c & 0xFC) != '0' && c < 0xC0)
+        c = code[++index];
+    return index;
+#endif
+}
+
+// States built by parse_program()
+struct state_table {
+    struct state *states;
+    unsigned long number_of_states;
+    unsigned long capacity;
+    size_t *source_offsets;  // Set by find_source_offsets() when profiling, or else NULL
+};
+
+// Doubles the number of states the table can hold, or allocates it if it is empty
+// Returns 1 if memory could not be allocated
+int grow_state_table(struct state_table *table) {
+    unsigned long capacity = table->capacity == 0 ? 1024 : table->capacity * 2;
+    struct state *states = realloc(table->states, capacity * sizeof(struct state));
+    if (states == NULL)
+        return 1;
+    table->states = states;
+    table->capacity = capacity;
+    return 0;
+}
+
+// Stores all states into the table based on the submitted code, reading it once
+// The state a branch goes to depends on the total number of states, so each branch first records its number of
+// 0 operators, and these are converted into states once the code has been read
+// Prints nothing, so that the library can report why a program could not be parsed without writing to standard error
+// Returns AXIOS_COMPILED, or else the reason the code could not be parsed, in which case the table is freed
+enum axios_compile_status parse_states(char code[], struct state_table *table) {
+    table->states = NULL;
+    table->capacity = 0;
+    table->source_offsets = NULL;
+    if (grow_state_table(table))
+        return AXIOS_COMPILE_OUT_OF_MEMORY;
+    table->states[0].outputs = 0;
+    table->states[0].inputs = 0;
+
+    unsigned long number_of_zeroes = 0;
+    unsigned long state_index = 0;
+    size_t code_index = skip_to_operator(code, 0);
+    unsigned char c = code[code_index];
+
+    while (1) {
+        if (c > 0xEF)
+            code_index += 4;
+        else if (c > 0xDF) {
+            c = identify_three_byte_operator(code, code_index);
+            code_index += 3;
+        } else if (c > 0xBF) {
+            c = identify_two_byte_operator(code, code_index);
+            code_index += 2;
+        } else {
+            code_index++;
+        }
+
+        switch (c) {
+            // States are indexed with 32 bits, so a state can have no more 0 operators than there can be states
+            case '0': {
+                if (++number_of_zeroes == UINT32_MAX) {
+                    free(table->states);
+                    return AXIOS_TOO_MANY_ZEROES;
+                }
+            } break;
+
+            // Ends the current state, which is also done at the end of the code
+            case '\0':
+            case '1': {
+                table->states[state_index].will_move_pointer = number_of_zeroes == 0 ? 255 : 0;
+                table->states[state_index].next_state = number_of_zeroes;
+                number_of_zeroes = 0;
+                if (c == '\0')
+                    break;
+                if (++state_index == UINT32_MAX - 1) {
+                    free(table->states);
+                    return AXIOS_TOO_MANY_STATES;
+                }
+                if (state_index == table->capacity && grow_state_table(table)) {
+                    free(table->states);
+                    return AXIOS_COMPILE_OUT_OF_MEMORY;
+                }
+                table->states[state_index].outputs = 0;
+                table->states[state_index].inputs = 0;
+            } break;
+
+            case '2': {
+                if (++table->states[state_index].outputs == 255) {
+                    free(table->states);
+                    return AXIOS_TOO_MANY_OUTPUTS;
+                }
+            } break;
+
+            case '3': {
+                if (++table->states[state_index].inputs == 255) {
+                    free(table->states);
+                    return AXIOS_TOO_MANY_INPUTS;
+                }
+            } break;
+        }
+        if (c == '\0')
+            break;
+        code_index = skip_to_operator(code, code_index);
+        c = code[code_index];
+    }
+    table->number_of_states = state_index + 1;
+
+    // A state with k 0 operators goes to the state k - 1 states before it, counting back from the first state
+    // to the termination state
+    unsigned long cycle_length = table->number_of_states + 1;
+    for (unsigned long state = 0; state < table->number_of_states; state++) {
+        if (table->states[state].will_move_pointer)
+            continue;
+        unsigned long zeroes = table->states[state].next_state;
+        if (zeroes <= state + 1)
+            table->states[state].next_state = state + 1 - zeroes;
+        else
+            table->states[state].next_state = (cycle_length - (zeroes - state - 1) % cycle_length) % cycle_length;
+    }
+    return AXIOS_COMPILED;
+}
+
+// Messages printed by parse_program(), in the order of enum axios_compile_status
+const char *parse_messages[] = {
+    "",
+    "Failed to allocate memory\n",
+    "Too many 0 operators in one state\n",
+    "Code uses too many states, exceeding limits on memory\n",
+    "Too many output operators in one state\nTry separating them into multiple states\n",
+    "Too many input operators in one state\nTry separating them into multiple states\n"
+};
+
+// Builds the table of states with parse_states(), printing why if the code could not be parsed
+// Returns 1 if the code could not be parsed, in which case the table is freed
+int parse_program(char code[], struct state_table *table) {
+    enum axios_compile_status status = parse_states(code, table);
+    if (status != AXIOS_COMPILED) {
+        fprintf(stderr, "%s", parse_messages[status]);
+        return 1;
+    }
+    return 0;
+}
+
+// Finds the byte offset in the code at which each state begins, just after the 1 operator ending the state before it
+// Returns 1 if memory could not be allocated
+int find_source_offsets(char code[], struct state_table *table) {
+    table->source_offsets = malloc(table->number_of_states * sizeof(size_t));
+    if (table->source_offsets == NULL)
+        return 1;
+    table->source_offsets[0] = 0;
+
+    unsigned long state_index = 0;
+    size_t code_index = skip_to_operator(code, 0);
+    unsigned char c = code[code_index];
+    while (c != '\0') {
+        if (c > 0xEF)
+            code_index += 4;
+        else if (c > 0xDF) {
+            c = identify_three_byte_operator(code, code_index);
+            code_index += 3;
+        } else if (c > 0xBF) {
+            c = identify_two_byte_operator(code, code_index);
+            code_index += 2;
+        } else
+            code_index++;
+
+        if (c == '1')
+            table->source_offsets[++state_index] = code_index;
+        code_index = skip_to_operator(code, code_index);
+        c = code[code_index];
+    }
+    return 0;
+}
+
+// Compiles the states for the chosen execution mode and runs the program
+void run_states(struct state_table *table, struct io *io) {
+    unsigned long number_of_states = table->number_of_states;
+
+    // Runs the states directly, counting what each one does
+    if (options.profile_file_name != NULL) {
+        struct state_profile *profile = calloc(number_of_states, sizeof(struct state_profile));
+        if (profile == NULL) {
+            fprintf(stderr, "Failed to allocate memory\n");
+            return;
+        }
+        size_t tape_length = run_profiled(table->states, number_of_states, profile, io);
+        if (tape_length != 0)
+            write_profile(table->states, number_of_states, profile, table->source_offsets, tape_length, options.profile_file_name);
+        free(profile);
+        return;
+    }
+
+    // Only run_program() writes and resumes checkpoints, so they always run the superinstructions
+    int checkpoints = options.checkpoint_file_name != NULL || options.resume_file_name != NULL;
+
+    // The profiled run above counts every state, so branches are only shortened for the other modes
+    if (thread_branches(table->states, number_of_states)) {
+        fprintf(stderr, "Failed to allocate memory\n");
+        return;
+    }
+
+    // Specializes each state into a handler, then runs them
+    // Endless loops are found among the superinstructions, so --detect-loops runs those as well
+    if ((options.execution_mode == THREADED || options.execution_mode == MEMOIZED) && !checkpoints && !options.detect_loops) {
+        struct threaded_state *threaded_states = malloc((number_of_states + 1) * sizeof(struct threaded_state));
+        if (threaded_states == NULL) {
+            fprintf(stderr, "Failed to allocate memory\n");
+            return;
+        }
+        compile_threaded_states(table->states, number_of_states, threaded_states);
+        if (options.execution_mode == MEMOIZED)
+            run_memoized(threaded_states, io);
+        else
+            run_threaded(threaded_states, io);
+        free(threaded_states);
+        return;
+    }
+
+    // Fuses the states into superinstructions, then runs them
+    // --detect-loops may add an instruction after the termination state for each instruction before it
+    size_t room = options.detect_loops ? 2 * (number_of_states + 1) : number_of_states + 1;
+    struct instruction *program = malloc(room * sizeof(struct instruction));
+    if (program == NULL) {
+        fprintf(stderr, "Failed to allocate memory\n");
+        return;
+    }
+    unsigned long number_of_instructions = compile_superinstructions(table->states, number_of_states, program);
+    if (number_of_instructions != 0)
+        number_of_instructions = remove_unreachable_instructions(program, number_of_instructions);
+    if (number_of_instructions != 0 && options.detect_loops)
+        number_of_instructions = mark_endless_loops(program, number_of_instructions);
+    if (number_of_instructions != 0) {
+#if defined(JIT_SUPPORTED)
+        // Compiles the superinstructions into machine code, then runs it
+        if (options.execution_mode == NATIVE_CODE && !checkpoints && run_native_code(program, number_of_instructions, io) == 0) {
+            free(program);
+            return;
+        }
+#endif
+        run_program(program, io);
+    }
+    free(program);
+}
+
+// Writes the program as C code if --emit-c was chosen, or else runs it, writing to output and reading from input
+// Input is NULL to read user input a line at a time from standard input
+void run_state_table(struct state_table *table, struct output *output, struct input *input) {
+    if (options.c_file_name != NULL) {
+        write_c_program(table->states, table->number_of_states, options.c_file_name);
+        return;
+    }
+
+    struct io io;
+    if (initialize_io(&io, output, input)) {
+        fprintf(stderr, "Failed to allocate memory\n");
+        return;
+    }
+    run_states(table, &io);
+    free_io(&io);
+}
+
+// Details the system keeps about a program file, which change whenever it is written
+struct source_identity {
+    uint64_t device;
+    uint64_t inode;
+    uint64_t size;
+    int64_t modified_seconds;
+    int64_t modified_nanoseconds;
+};
+
+#if defined(__unix__) || defined(__APPLE__)
+
+#define CACHE_MAGIC "AXIOSPC1"
+
+// Start of a file written by --cache, followed by the states of the program as they are held in memory
+struct cache_header {
+    char magic[8];
+    struct source_identity source;  // The program file the states were parsed from
+    uint64_t number_of_states;
+};
+
+// Returns 1 if the file could not be found
+int identify_source(char file_name[], struct source_identity *identity) {
+    struct stat status;
+    if (stat(file_name, &status) != 0)
+        return 1;
+    memset(identity, 0, sizeof(struct source_identity));
+    identity->device = status.st_dev;
+    identity->inode = status.st_ino;
+    identity->size = status.st_size;
+    identity->modified_seconds = status.st_mtime;
+#if defined(__APPLE__)
+    identity->modified_nanoseconds = status.st_mtimespec.tv_nsec;
+#else
+    identity->modified_nanoseconds = status.st_mtim.tv_nsec;
+#endif
+    return 0;
+}
+
+// Checks that every state could have been made by parse_states(), so that a damaged cache, or one written by another
+// build, cannot send the runners past the end of the states
+// Returns 1 if any state could not have been parsed
+int check_cached_states(struct state states[], uint64_t number_of_states) {
+    if (number_of_states >= UINT32_MAX - 1)
+        return 1;
+    for (uint64_t state = 0; state < number_of_states; state++) {
+        unsigned char will_move_pointer = states[state].will_move_pointer;
+        if (will_move_pointer != 0 && will_move_pointer != 255)
+            return 1;
+        if (will_move_pointer == 0 && states[state].next_state > number_of_states)
+            return 1;
+        if (states[state].outputs == 255 || states[state].inputs == 255)
+            return 1;
+    }
+    return 0;
+}
+
+// Runs the states in the file chosen by --cache straight from memory, mapping the file rather than reading it
+// Returns 1 without running anything if the file is missing, was made from another version of the program file or
+// holds states that could not have been parsed
+int run_cached_program(struct source_identity *identity) {
+    int file_descriptor = open(options.cache_file_name, O_RDONLY);
+    if (file_descriptor < 0)
+        return 1;
+    struct stat status;
+    if (fstat(file_descriptor, &status) != 0 || (size_t) status.st_size < sizeof(struct cache_header)) {
+        close(file_descriptor);
+        return 1;
+    }
+
+    // The mapping is private and writable, so the states can be used as if they had just been parsed
+    size_t size = status.st_size;
+    char *mapping = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE, file_descriptor, 0);
+    close(file_descriptor);
+    if (mapping == MAP_FAILED)
+        return 1;
+    struct cache_header *header = (struct cache_header*) mapping;
+    size_t states_size = size - sizeof(struct cache_header);
+    if (memcmp(header->magic, CACHE_MAGIC, 8) != 0 || memcmp(&header->source, identity, sizeof(struct source_identity)) != 0 || header->number_of_states == 0 || states_size % sizeof(struct state) != 0 || states_size / sizeof(struct state) != header->number_of_states || check_cached_states((struct state*) (mapping + sizeof(struct cache_header)), header->number_of_states)) {
+        munmap(mapping, size);
+        return 1;
+    }
+
+    struct state_table table;
+    table.states = (struct state*) (mapping + sizeof(struct cache_header));
+    table.number_of_states = header->number_of_states;
+    table.capacity = header->number_of_states;
+    table.source_offsets = NULL;
+    struct counters counters;
+    int64_t run_counts[NUMBER_OF_COUNTERS];
+    if (options.counters)
+        start_counters(&counters);
+    run_state_table(&table, &output, options.batch_input ? &input : NULL);
+    if (options.counters) {
+        stop_counters(&counters, run_counts);
+        print_counters(NULL, run_counts);
+    }
+    munmap(mapping, size);
+    return 0;
+}
+
+// Writes the states of a program to the file chosen by --cache, beside the old file and then replacing it, so a cache
+// is never left partly written
+void write_program_cache(struct state_table *table, struct source_identity *identity) {
+    struct cache_header header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, CACHE_MAGIC, 8);
+    header.source = *identity;
+    header.number_of_states = table->number_of_states;
+    struct iovec vectors[2] = {
+        {&header, sizeof(header)},
+        {table->states, table->number_of_states * sizeof(struct state)}
+    };
+
+    char temporary_name[4096];
+    snprintf(temporary_name, sizeof(temporary_name), "%s.tmp", options.cache_file_name);
+    int file_descriptor = open(temporary_name, O_WRONLY | O_CREAT | O_TRUNC, 0666);
+    int failed = file_descriptor < 0 || write_vectors(file_descriptor, vectors, 2);
+    if (file_descriptor >= 0 && close(file_descriptor) != 0)
+        failed = 1;
+    if (!failed && rename(temporary_name, options.cache_file_name) != 0)
+        failed = 1;
+    if (failed) {
+        fprintf(stderr, "Failed to write cache %s\n", options.cache_file_name);
+        unlink(temporary_name);
+    }
+}
+
+#else
+
+int identify_source(char file_name[], struct source_identity *identity) {
+    fprintf(stderr, "Program caches are only supported on Unix-like systems\n");
+    return 1;
+}
+
+int run_cached_program(struct source_identity *identity) {
+    return 1;
+}
+
+void write_program_cache(struct state_table *table, struct source_identity *identity) {}
+
+#endif
+
+// Parses the code, then runs the program
+// If the code was read from a file identified by source, the states are saved for --cache before running
+void read_program(char code[], struct source_identity *source) {
+    // --counters measures parsing and running separately
+    struct counters counters;
+    int64_t parse_counts[NUMBER_OF_COUNTERS], run_counts[NUMBER_OF_COUNTERS];
+    if (options.counters)
+        start_counters(&counters);
+    struct state_table table;
+    int failed = parse_program(code, &table);
+    if (options.counters)
+        stop_counters(&counters, parse_counts);
+    if (failed)
+        return;
+
+    if (options.profile_file_name != NULL && find_source_offsets(code, &table)) {
+        fprintf(stderr, "Failed to allocate memory\n");
+        free(table.states);
+        return;
+    }
+    if (source != NULL)
+        write_program_cache(&table, source);
+    if (options.counters)
+        start_counters(&counters);
+    run_state_table(&table, &output, options.batch_input ? &input : NULL);
+    if (options.counters) {
+        stop_counters(&counters, run_counts);
+        print_counters(parse_counts, run_counts);
+    }
+    free(table.states);
+    free(table.source_offsets);
+}
+
+
+
+// Input Code
+
+// Reads all of a file into memory, a block at a time, followed by null characters marking the end of the code
+// Returns NULL if memory could not be allocated
+char* read_code(FILE *file) {
+    size_t capacity = 65536;
+    size_t length = 0;
+    char *code = malloc(capacity);
+    if (code == NULL)
+        return NULL;
+
+    // Four null characters are kept after the code, since a character may be read past its first byte
+    while (1) {
+        length += fread(code + length, 1, capacity - 4 - length, file);
+        if (length < capacity - 4)
+            break;
+        char *new_code = realloc(code, capacity * 2);
+        if (new_code == NULL) {
+            free(code);
+            return NULL;
+        }
+        code = new_code;
+        capacity *= 2;
+    }
+    memset(code + length, 0, 4);
+    return code;
+}
+
+// Opens file, records the code contained inside, and calls read_program()
+// With --cache, a program whose cache was made from the file as it is now runs without its code being read, and other
+// programs have their cache written. --profile needs the code itself to find where each state begins, so it reads it
+int read_code_from_file(char file_name[]) {
+    struct source_identity identity;
+    int caching = options.cache_file_name != NULL && options.profile_file_name == NULL && identify_source(file_name, &identity) == 0;
+    if (caching && run_cached_program(&identity) == 0)
+        return 0;
+
+    FILE *file;
+    file = fopen(file_name, "rb");
+    if (file == NULL) {
+        fprintf(stderr, "File not found\n");
+        return 1;
+    }
+
+    char *code = read_code(file);
+    fclose(file);
+    if (code == NULL) {
+        fprintf(stderr, "Failed to allocate memory\n");
+        return 1;
+    }
+
+    read_program(code, caching ? &identity : NULL);
+    free(code);
+    return 0;
+}
+
+// Reads a file name from user input
+void input_file_name(char file_name[]) {
+    printf("\nType the name of your file: ");
+    fgets(file_name, 2, stdin); // Buffer function needed, or no user input will be read
+    fgets(file_name, 256, stdin);
+
+    // Replaces the newline character at the end of file_name with the null character, so the correct file name will be passed to fopen()
+    for (int i = 0; i < 255; i++) {
+        if (file_name[i] == '\n') {
+            file_name[i] = '\0';
+            break;
+        }
+    }
+    
+     // Ensures the last character is the null character in case the user's input exceeded the length of file_name
+    file_name[255] = '\0';
+}
+
+// Returns 1 if an argument is an option rather than part of the file name
+int is_option(char argument[]) {
+    return argument[0] == '-' && argument[1] == '-';
+}
+
+// Reads options (arguments beginning with "--") at program start
+// Returns 1 if an option is not recognized
+int get_options_from_argv(int argc, char **argv) {
+    for (int i = 1; i < argc; i++) {
+        if (!is_option(argv[i]))
+            continue;
+        if (strcmp(argv[i], "--threaded") == 0)
+            options.execution_mode = THREADED;
+        else if (strncmp(argv[i], "--emit-c=", 9) == 0 && argv[i][9] != 0)
+            options.c_file_name = argv[i] + 9;
+        else if (strncmp(argv[i], "--output=", 9) == 0 && argv[i][9] != 0)
+            options.output_file_name = argv[i] + 9;
+        else if (strcmp(argv[i], "--flush=newline") == 0)
+            options.flush_policy = FLUSH_ON_NEWLINE;
+        else if (strcmp(argv[i], "--flush=input") == 0)
+            options.flush_policy = FLUSH_ON_INPUT;
+        else if (strcmp(argv[i], "--flush=exit") == 0)
+            options.flush_policy = FLUSH_ON_EXIT;
+        else if (strncmp(argv[i], "--flush=", 8) == 0 && argv[i][8] >= '1' && argv[i][8] <= '9' && strspn(argv[i] + 8, "0123456789") == strlen(argv[i] + 8)) {
+            options.flush_policy = FLUSH_ON_EXIT;
+            options.flush_threshold = strtoul(argv[i] + 8, NULL, 10);
+        } else if (strcmp(argv[i], "--memoize") == 0)
+            options.execution_mode = MEMOIZED;
+        else if (strcmp(argv[i], "--jit") == 0)
+            options.execution_mode = NATIVE_CODE;
+        else if (strcmp(argv[i], "--superinstructions") == 0)
+            options.execution_mode = SUPERINSTRUCTIONS;
+        else if (strncmp(argv[i], "--profile=", 10) == 0 && argv[i][10] != 0)
+            options.profile_file_name = argv[i] + 10;
+        else if (strncmp(argv[i], "--checkpoint=", 13) == 0 && argv[i][13] != 0)
+            options.checkpoint_file_name = argv[i] + 13;
+        else if (strncmp(argv[i], "--checkpoint-interval=", 22) == 0 && argv[i][22] >= '1' && argv[i][22] <= '9' && strspn(argv[i] + 22, "0123456789") == strlen(argv[i] + 22))
+            options.checkpoint_interval = strtoul(argv[i] + 22, NULL, 10);
+        else if (strncmp(argv[i], "--resume=", 9) == 0 && argv[i][9] != 0)
+            options.resume_file_name = argv[i] + 9;
+        else if (strcmp(argv[i], "--benchmark") == 0)
+            options.benchmark = 1;
+        else if (strcmp(argv[i], "--detect-loops") == 0)
+            options.detect_loops = 1;
+        else if (strncmp(argv[i], "--cache=", 8) == 0 && argv[i][8] != 0)
+            options.cache_file_name = argv[i] + 8;
+        else if (strcmp(argv[i], "--counters") == 0)
+            options.counters = 1;
+        else if (strcmp(argv[i], "--async-io") == 0)
+            options.async_io = 1;
+        else if (strncmp(argv[i], "--jobs=", 7) == 0 && argv[i][7] != 0)
+            options.jobs_file_name = argv[i] + 7;
+        else if (strcmp(argv[i], "--ensemble") == 0)
+            options.ensemble = 1;
+        else if (strncmp(argv[i], "--threads=", 10) == 0 && argv[i][10] >= '1' && argv[i][10] <= '9' && strspn(argv[i] + 10, "0123456789") == strlen(argv[i] + 10))
+            options.number_of_threads = strtoul(argv[i] + 10, NULL, 10);
+        else if (strcmp(argv[i], "--batch") == 0)
+            options.batch_input = 1;
+        else if (strncmp(argv[i], "--input=", 8) == 0 && argv[i][8] != 0) {
+            options.batch_input = 1;
+            options.batch_file_name = argv[i] + 8;
+        }
+        else {
+            fprintf(stderr, "Unknown option: %s\n", argv[i]);
+            return 1;
+        }
+    }
+    return 0;
+}
+
+// Reads file name from argument(s) at program start, skipping options
+int get_file_from_argv(char file_name[], int argc, char **argv) {
+    size_t index = 0;
+    
+    // Iteratively adds the characters of all arguments to file_name
+    for (size_t i = 1; i < argc; i++) {
+        if (is_option(argv[i]))
+            continue;
+
+        // In the command line, two arguments are separated by a space
+        // I add the space here to treat that space as part of the file name
+        if (index != 0) {
+            file_name[index] = ' ';
+            index++;
+            if (index >= 256) {
+                printf("The name of your file or path is too long");
+                return 1;
+            }
+        }
+
+        char *ch;
+        ch = &(argv[i][0]);
+        
+        // Adds each character in a single argument to file_name
+        while (*ch != '\0') {
+            file_name[index] = *ch;
+            index++; ch++;
+            if (index >= 256) {
+                printf("The name of your file or path is too long");
+                return 1;
+            }
+        }
+    }
+    
+    // Marks the end of the file name
+    file_name[index] = '\0';
+    return 0;
+}
+
+// Runs the shell and calls read_program() until "2" is entered
+void run_shell() {
+    char code[131072] = {0};
+    size_t code_index = 0;
+    fgets(code, 2, stdin); // Buffer function needed, or no user input will be read
+    printf("\n>>> ");
+    fgets(code, 131072, stdin);
 
-                // Tamil numerals
-                case '\xAF': {
-                    switch(string[index+2]) {
-                        case '\xA6': return '0';
-                        case '\xA7': return '1';
-                        case '\xA8': return '2';
-                        case '\xA9': return '3';
-                }} break;
+    while ((code[0] != '2' || code[1] != '\n')  && (identify_two_byte_operator(code, 0) != '2' || code[2] != '\n') && (identify_three_byte_operator(code, 0) != '2' || code[3] != '\n')) {
+        if (code[131071] == '\0')
+            read_program(code, NULL);
+        else
+            fprintf(stderr, "Code is too long, exceeding limits on memory");
 
-                // Thai numerals
-                case '\xB9': {
-                    switch(string[index+2]) {
-                        case '\x90': return '0';
-                        case '\x91': return '1';
-                        case '\x92': return '2';
-                        case '\x93': return '3';
-                }} break;
+        code_index = 0;
+        while (code_index < 131072) {
+            code[code_index] = '\0';
+            code_index++;
+        }
+        printf("\n>>> ");
+        fgets(code, 131072, stdin);
+    }
+}
 
-                // Lao numerals
-                case '\xBB': {
-                    switch(string[index+2]) {
-                        case '\x90': return '0';
-                        case '\x91': return '1';
-                        case '\x92': return '2';
-                        case '\x93': return '3';
-                }} break;
 
-                // Tibetan numerals
-                case '\xBC': {
-                    switch(string[index+2]) {
-                        case '\xA0': return '0';
-                        case '\xA1': return '1';
-                        case '\xA2': return '2';
-                        case '\xA3': return '3';
-                }} break;
-        }} break;
 
-        case '\xE1': {
-            switch (string[index+1]) {
-                // Burmese numerals
-                case '\x81': {
-                    switch (string[index+2]) {
-                        case '\x80': return '0';
-                        case '\x81': return '1';
-                        case '\x82': return '2';
-                        case '\x83': return '3';
-                }} break;
+// Benchmark
 
-                // Khmer numerals
-                case '\x9F': {
-                    switch (string[index+2]) {
-                        case '\xA0': return '0';
-                        case '\xA1': return '1';
-                        case '\xA2': return '2';
-                        case '\xA3': return '3';
-                }} break;
-        }} break;
+#if defined(__unix__) || defined(__APPLE__)
 
-        // Fullwidth numerals
-        case '\xEF': {
-            if (string[index+1] == '\xBC') {
-                switch (string[index+2]) {
-                    case '\x90': return '0';
-                    case '\x91': return '1';
-                    case '\x92': return '2';
-                    case '\x93': return '3';
-        }}} break;
+// Bytes of output after which the Turing Completeness Proof, which never ends, is stopped
+#define BENCHMARK_PROOF_OUTPUT 20000
+
+// Bytes of output after which the heavy output program, which never ends, is stopped
+#define BENCHMARK_HEAVY_OUTPUT 4194304
+
+// A program run by --benchmark, along with the input given to it
+struct benchmark_program {
+    char *name;
+    char *code;           // Followed by four null characters, as from read_code()
+    char *input;          // Input given to the program, or NULL for input_length bytes from build_input()
+    size_t input_length;
+    size_t output_limit;  // Bytes of output after which the program is stopped, or zero to run it to the end
+};
+
+// A way of running a program compared by --benchmark
+struct benchmark_mode {
+    char *name;
+    enum execution_mode execution_mode;
+    unsigned char profiled;  // Set to run the program with run_profiled(), which counts its steps
+};
+
+// Measurements sent back by the child process in which a program was run
+struct benchmark_result {
+    double parse_seconds;
+    double run_seconds;
+    uint64_t steps;
+    uint64_t tape_growths;
+    int64_t run_counts[NUMBER_OF_COUNTERS];  // Set by --counters, or else -1
+};
+
+// Variables used by end_benchmark_run() in the child process
+struct benchmark_run {
+    int pipe;
+    double run_start;
+    struct benchmark_result result;
+    struct state_profile *profile;
+    unsigned long number_of_states;
+    struct counters counters;
+} benchmark_run;
+
+// Returns the time in seconds from an arbitrary starting point, unaffected by changes to the system clock
+double current_seconds() {
+    struct timespec time;
+    clock_gettime(CLOCK_MONOTONIC, &time);
+    return time.tv_sec + time.tv_nsec / 1e9;
+}
+
+// Sends the measurements of a run to the parent process and ends the child process
+// Also called through flush_output() once a program reaches its output limit
+void end_benchmark_run() {
+    benchmark_run.result.run_seconds = current_seconds() - benchmark_run.run_start;
+    if (options.counters)
+        stop_counters(&benchmark_run.counters, benchmark_run.result.run_counts);
+    else {
+        for (int i = 0; i < NUMBER_OF_COUNTERS; i++)
+            benchmark_run.result.run_counts[i] = -1;
+    }
+    benchmark_run.result.steps = 0;
+    benchmark_run.result.tape_growths = 0;
+    if (benchmark_run.profile != NULL) {
+        for (unsigned long state = 0; state < benchmark_run.number_of_states; state++) {
+            benchmark_run.result.steps += benchmark_run.profile[state].executions;
+            benchmark_run.result.tape_growths += benchmark_run.profile[state].tape_growths;
+        }
     }
+    if (write(benchmark_run.pipe, &benchmark_run.result, sizeof(struct benchmark_result)) != sizeof(struct benchmark_result))
+        _exit(1);
+    _exit(0);
+}
 
-    return 'N';
+// Runs a program in a child process, reading batch input from input_path and writing output to output_path
+void run_benchmark_child(struct benchmark_program *program, struct benchmark_mode *mode, char input_path[], char output_path[]) {
+    options.execution_mode = mode->execution_mode;
+    options.c_file_name = NULL;
+    options.profile_file_name = NULL;
+    options.batch_input = 1;
+    options.flush_policy = FLUSH_ON_EXIT;
+    options.flush_threshold = program->output_limit;
+    if (open_output(&output, output_path) || open_input(&input, input_path))
+        _exit(1);
+    if (program->output_limit != 0)
+        output.full_handler = end_benchmark_run;
+
+    double start = current_seconds();
+    struct state_table table;
+    if (parse_program(program->code, &table))
+        _exit(1);
+    benchmark_run.result.parse_seconds = current_seconds() - start;
+
+    if (options.counters)
+        start_counters(&benchmark_run.counters);
+    benchmark_run.run_start = current_seconds();
+    if (mode->profiled) {
+        benchmark_run.number_of_states = table.number_of_states;
+        benchmark_run.profile = calloc(table.number_of_states, sizeof(struct state_profile));
+        struct io io;
+        if (benchmark_run.profile == NULL || initialize_io(&io, &output, &input))
+            _exit(1);
+        run_profiled(table.states, table.number_of_states, benchmark_run.profile, &io);
+        free_io(&io);
+    } else
+        run_state_table(&table, &output, &input);
+    end_benchmark_run();
+}
+
+// Returns 1 if two files hold the same bytes
+int files_match(char first_path[], char second_path[]) {
+    FILE *first = fopen(first_path, "rb");
+    FILE *second = fopen(second_path, "rb");
+    int match = first != NULL && second != NULL;
+    static char first_block[65536], second_block[65536];
+    while (match) {
+        size_t length = fread(first_block, 1, sizeof(first_block), first);
+        if (fread(second_block, 1, sizeof(second_block), second) != length || memcmp(first_block, second_block, length) != 0)
+            match = 0;
+        else if (length == 0)
+            break;
+    }
+    if (first != NULL)
+        fclose(first);
+    if (second != NULL)
+        fclose(second);
+    return match;
+}
+
+// Returns length bytes of lines of lowercase letters, the same every time
+// Returns NULL if memory could not be allocated
+char* build_input(size_t length) {
+    char *input = malloc(length + 1);
+    if (input == NULL)
+        return NULL;
+    uint32_t random = 1;
+    for (size_t i = 0; i < length; i++) {
+        random = random * 1103515245 + 12345;
+        input[i] = "abcdefghij\n"[(random >> 16) % 11];
+    }
+    return input;
+}
+
+// Runs a program once in each mode, each time in a new process so that its peak memory use can be measured alone,
+// and prints a line of measurements for each
+// The first mode counts the program's steps, and the output of each other mode is compared against it
+// Returns 1 if a run failed or its output differed
+int benchmark_program(struct benchmark_program *program, struct benchmark_mode modes[], int number_of_modes, char directory[]) {
+    char input_path[4096], reference_path[4096], output_path[4096];
+    snprintf(input_path, sizeof(input_path), "%s/input", directory);
+    snprintf(reference_path, sizeof(reference_path), "%s/reference", directory);
+    snprintf(output_path, sizeof(output_path), "%s/output", directory);
+
+    // Generated input is freed before any child process starts, so that it does not count towards their memory use
+    char *input = program->input == NULL ? build_input(program->input_length) : program->input;
+    if (input == NULL) {
+        fprintf(stderr, "Failed to allocate memory\n");
+        return 1;
+    }
+    FILE *input_file = fopen(input_path, "wb");
+    int written = input_file != NULL && fwrite(input, 1, program->input_length, input_file) == program->input_length;
+    if (input_file != NULL && fclose(input_file) != 0)
+        written = 0;
+    if (input != program->input)
+        free(input);
+    if (!written) {
+        fprintf(stderr, "Failed to write file %s\n", input_path);
+        return 1;
+    }
+
+    int failed = 0;
+    uint64_t steps = 0;
+    uint64_t tape_growths = 0;
+    for (int i = 0; i < number_of_modes; i++) {
+        char *path = i == 0 ? reference_path : output_path;
+        int pipe_ends[2];
+        if (pipe(pipe_ends) != 0) {
+            fprintf(stderr, "Failed to create pipe\n");
+            return 1;
+        }
+
+        // Buffered text would otherwise be printed by both processes
+        fflush(stdout);
+        fflush(stderr);
+        pid_t child = fork();
+        if (child == 0) {
+            close(pipe_ends[0]);
+            benchmark_run.pipe = pipe_ends[1];
+            run_benchmark_child(program, &modes[i], input_path, path);
+        }
+        close(pipe_ends[1]);
+
+        struct benchmark_result result;
+        ssize_t length = child < 0 ? 0 : read(pipe_ends[0], &result, sizeof(result));
+        close(pipe_ends[0]);
+        struct rusage usage;
+        int status;
+        if (child > 0)
+            wait4(child, &status, 0, &usage);
+
+        const char *name = i == 0 ? program->name : "";
+        if (length != sizeof(result)) {
+            printf("%-32s %-18s failed\n", name, modes[i].name);
+            failed = 1;
+            continue;
+        }
+        if (i == 0) {
+            steps = result.steps;
+            tape_growths = result.tape_growths;
+        }
+
+        // ru_maxrss is given in bytes on macOS and in kilobytes elsewhere
+        long peak_kilobytes = usage.ru_maxrss;
+#if defined(__APPLE__)
+        peak_kilobytes /= 1024;
+#endif
+        const char *comparison = "reference";
+        if (i != 0) {
+            comparison = files_match(reference_path, output_path) ? "identical" : "DIFFERENT";
+            if (comparison[0] == 'D')
+                failed = 1;
+        }
+        printf("%-32s %-18s %14llu %10.3f %10.3f %10.1f %10ld  %-9s", name, modes[i].name, (unsigned long long) steps,
+               result.parse_seconds * 1e3, result.run_seconds * 1e3,
+               result.run_seconds > 0 ? steps / result.run_seconds / 1e6 : 0.0, peak_kilobytes, comparison);
+
+        // With --counters, the counts of the run follow, with - for any the system could not provide
+        if (options.counters) {
+            printf(" %12llu", (unsigned long long) tape_growths);
+            int64_t *counts = result.run_counts;
+            if (counts[CYCLES] > 0 && counts[INSTRUCTIONS] >= 0)
+                printf(" %6.2f", (double) counts[INSTRUCTIONS] / counts[CYCLES]);
+            else
+                printf(" %6s", "-");
+            for (int j = BRANCH_MISSES; j < NUMBER_OF_COUNTERS; j++) {
+                if (counts[j] >= 0)
+                    printf(" %14lld", (long long) counts[j]);
+                else
+                    printf(" %14s", "-");
+            }
+        }
+        printf("\n");
+    }
+    unlink(input_path);
+    unlink(reference_path);
+    unlink(output_path);
+    return failed;
+}
+
+// Returns the code of a program read from a file, or NULL if the file could not be read
+char* read_benchmark_code(char file_name[]) {
+    FILE *file = fopen(file_name, "rb");
+    if (file == NULL)
+        return NULL;
+    char *code = read_code(file);
+    fclose(file);
+    return code;
+}
+
+// A piece of a synthetic program's code, repeated a number of times
+struct code_piece {
+    char *text;
+    size_t copies;
+};
+
+// Returns the code made by joining the pieces, followed by four null characters
+// Returns NULL if memory could not be allocated
+char* build_code(struct code_piece pieces[], int number_of_pieces) {
+    size_t length = 0;
+    for (int i = 0; i < number_of_pieces; i++)
+        length += strlen(pieces[i].text) * pieces[i].copies;
+    char *code = malloc(length + 4);
+    if (code == NULL)
+        return NULL;
+    length = 0;
+    for (int i = 0; i < number_of_pieces; i++) {
+        size_t text_length = strlen(pieces[i].text);
+        for (size_t copy = 0; copy < pieces[i].copies; copy++) {
+            memcpy(code + length, pieces[i].text, text_length);
+            length += text_length;
+        }
+    }
+    memset(code + length, 0, 4);
+    return code;
+}
+
+// Runs the benchmark suite, or only the program in file_name if one is given, in every execution mode
+// Programs are read from the "Example Programs" folder in the current directory, and skipped if they are not found
+// Returns 1 if a program could not be run or the modes did not produce identical output
+int run_benchmarks(char file_name[]) {
+    struct benchmark_mode modes[] = {
+        {"profiled", SUPERINSTRUCTIONS, 1},
+        {"superinstructions", SUPERINSTRUCTIONS, 0},
+        {"threaded", THREADED, 0},
+        {"memoize", MEMOIZED, 0},
+#if defined(JIT_SUPPORTED)
+        {"jit", NATIVE_CODE, 0},
+#endif
+    };
+    int number_of_modes = sizeof(modes) / sizeof(modes[0]);
+
+    // Synthetic programs, each of which runs until the end of its input or until its output limit is reached
+    // Deep tape: a run of 4000 states moving the pointer for each character of input, so the cells array grows long
+    // Tight loop: a two-state loop moving the pointer past zero cells, all the way around the cells array for each
+    // character of input
+    // Heavy output: a two-state loop outputting a bit in each state
+    // Heavy input: copies each bit of input to the output
+    struct benchmark_program programs[7];
+    int number_of_programs;
+    if (file_name[0] != '\0') {
+        programs[0] = (struct benchmark_program) {file_name, read_benchmark_code(file_name), "", 0, BENCHMARK_HEAVY_OUTPUT};
+        number_of_programs = 1;
+    } else {
+        programs[0] = (struct benchmark_program) {"hello world", read_benchmark_code("Example Programs/hello world.txt"), "", 0, 0};
+        programs[1] = (struct benchmark_program) {"proof (input 0110)", read_benchmark_code("Example Programs/Turing Completeness Proof.txt"), "0110\n", 5, BENCHMARK_PROOF_OUTPUT};
+        programs[2] = (struct benchmark_program) {"proof without comments", read_benchmark_code("Example Programs/Turing Completeness Proof without comments.txt"), "0110\n", 5, BENCHMARK_PROOF_OUTPUT};
+        programs[3] = (struct benchmark_program) {"deep tape", build_code((struct code_piece[]) {{"3", 21}, {"1", 4001}, {"0", 4002}, {"1", 1}, {"0", 4003}}, 5), NULL, 100000, 0};
+        programs[4] = (struct benchmark_program) {"tight loop", build_code((struct code_piece[]) {{"3", 21}, {"11", 1}, {"00", 1}, {"11", 1}, {"00000", 1}, {"1", 1}, {"000000", 1}}, 7), NULL, 20000, 0};
+        programs[5] = (struct benchmark_program) {"heavy output", build_code((struct code_piece[]) {{"201", 1}, {"200", 1}}, 2), "", 0, BENCHMARK_HEAVY_OUTPUT};
+        programs[6] = (struct benchmark_program) {"heavy input", build_code((struct code_piece[]) {{"321", 21}, {"0", 22}, {"1", 1}, {"0", 23}}, 4), NULL, 4194304, 0};
+        number_of_programs = 7;
+    }
+
+    char directory[] = "/tmp/axios-benchmark-XXXXXX";
+    if (mkdtemp(directory) == NULL) {
+        fprintf(stderr, "Failed to create a temporary folder\n");
+        return 1;
+    }
+
+    int failed = 0;
+    printf("%-32s %-18s %14s %10s %10s %10s %10s  %-9s", "program", "mode", "steps", "parse ms", "run ms", "Msteps/s", "peak KiB", "output");
+    if (options.counters) {
+        printf(" %12s %6s", "growths", "IPC");
+        for (int i = BRANCH_MISSES; i < NUMBER_OF_COUNTERS; i++)
+            printf(" %14s", counter_names[i]);
+    }
+    printf("\n");
+    for (int i = 0; i < number_of_programs; i++) {
+        if (programs[i].code == NULL) {
+            printf("%-32s could not be read\n", programs[i].name);
+            failed = 1;
+        } else if (benchmark_program(&programs[i], modes, number_of_modes, directory))
+            failed = 1;
+        free(programs[i].code);
+    }
+    rmdir(directory);
+    return failed;
+}
+
+#else
+
+int run_benchmarks(char file_name[]) {
+    fprintf(stderr, "--benchmark runs each program in a separate process, which is only supported on Unix-like systems\n");
+    return 1;
+}
+
+#endif
+
+
+
+// Ensembles
+
+// Number of machines run by an ensemble, one for each bit of a word
+#define LANES 64
+
+// Number of instructions a group runs before the groups behind it get a turn
+#define ENSEMBLE_SLICE 4096
+
+// Cells of every lane of an ensemble, stored bit-sliced so that each word holds the same cell of all 64 lanes
+// Every lane changes only the cells up to its own last bit, so cells past it stay zero until the lane adds them
+struct sliced_cells {
+    uint64_t *words;
+    size_t capacity;  // Number of words allocated
+};
+
+// Lanes at the same instruction with the same pointer and the same number of cells
+// Lanes only come to share these by taking the same path through the program, so a group runs each instruction once
+// for all of its lanes, changing their cells a word at a time
+struct lane_group {
+    uint64_t lanes;  // One bit for each lane in the group
+    unsigned long instruction_index;
+    size_t current_bit;
+    size_t last_bit;
+};
+
+// Groups waiting for a turn, along with the number of them waiting at each instruction
+struct lane_groups {
+    struct lane_group groups[LANES];
+    unsigned int number_of_groups;
+    unsigned char *waiting;
+};
+
+// Adds a new cell to the end of a group's cells, growing the cells of every lane if it is the longest
+// Returns 1 if memory could not be allocated
+int add_sliced_cell(struct sliced_cells *cells, size_t *last_bit) {
+    (*last_bit)++;
+    if (*last_bit == cells->capacity) {
+        uint64_t *words = realloc(cells->words, cells->capacity * 2 * sizeof(uint64_t));
+        if (words == NULL)
+            return 1;
+        memset(words + cells->capacity, 0, cells->capacity * sizeof(uint64_t));
+        cells->words = words;
+        cells->capacity *= 2;
+    }
+    return 0;
+}
+
+// Changes the current cell of a group's lanes and moves the pointer forward, count times in a row, as advance_pointer()
+// does for one machine
+// Returns 1 if memory could not be allocated
+int advance_lanes(struct sliced_cells *cells, uint64_t lanes, size_t *current_bit, size_t *last_bit, unsigned long count) {
+    while (count > 0) {
+        if (*current_bit == *last_bit) {
+            cells->words[*current_bit] ^= lanes;
+            *current_bit = 0;
+            count--;
+            if (add_sliced_cell(cells, last_bit))
+                return 1;
+            continue;
+        }
+
+        size_t run = *last_bit - *current_bit;
+        if (run > count)
+            run = count;
+        uint64_t *words = cells->words + *current_bit;
+        for (size_t i = 0; i < run; i++)
+            words[i] ^= lanes;
+        *current_bit += run;
+        count -= run;
+    }
+    return 0;
+}
+
+// Returns the first cell from current_bit up to the last bit in which any of the lanes is one, or the cell after the last
+// bit if there is none, as find_one() does for one machine
+size_t find_lanes_one(struct sliced_cells *cells, uint64_t lanes, size_t current_bit, size_t last_bit) {
+    uint64_t *words = cells->words;
+    size_t bit = current_bit;
+
+    // Long runs of zero cells are skipped four at a time
+    while (last_bit - bit >= 4 && ((words[bit] | words[bit + 1] | words[bit + 2] | words[bit + 3]) & lanes) == 0)
+        bit += 4;
+    while (bit <= last_bit && (words[bit] & lanes) == 0)
+        bit++;
+    return bit;
+}
+
+// Adds a group to those waiting, joining it to a group already waiting with the same instruction, pointer and cells
+void add_lane_group(struct lane_groups *groups, struct lane_group *group) {
+    if (groups->waiting[group->instruction_index]) {
+        for (unsigned int i = 0; i < groups->number_of_groups; i++) {
+            struct lane_group *other = &groups->groups[i];
+            if (other->instruction_index == group->instruction_index && other->current_bit == group->current_bit && other->last_bit == group->last_bit) {
+                other->lanes |= group->lanes;
+                return;
+            }
+        }
+    }
+    groups->groups[groups->number_of_groups++] = *group;
+    groups->waiting[group->instruction_index]++;
+}
+
+// Returns 1 if a group is waiting that the running group could join
+int can_join(struct lane_groups *groups, unsigned long instruction_index, size_t current_bit, size_t last_bit) {
+    if (!groups->waiting[instruction_index])
+        return 0;
+    for (unsigned int i = 0; i < groups->number_of_groups; i++) {
+        struct lane_group *other = &groups->groups[i];
+        if (other->instruction_index == instruction_index && other->current_bit == current_bit && other->last_bit == last_bit)
+            return 1;
+    }
+    return 0;
+}
+
+// Runs the program on number_of_lanes machines at once, each with its own cells, input and output
+// Each lane behaves exactly as if it were run by run_program(), but lanes following the same path share each step, so
+// a program given many inputs that rarely change which way it branches runs in little more time than for one
+// When lanes branch different ways, their group splits in two, and the group furthest behind in the program runs
+// first so that groups ahead can be joined again once they meet
+void run_ensemble(struct instruction program[], unsigned long number_of_instructions, struct io io[], unsigned int number_of_lanes) {
+    struct sliced_cells cells;
+    cells.capacity = 256;
+    cells.words = calloc(cells.capacity, sizeof(uint64_t));
+    struct lane_groups groups;
+    groups.waiting = calloc(number_of_instructions, sizeof(unsigned char));
+    if (cells.words == NULL || groups.waiting == NULL) {
+        fprintf(stderr, "Failed to allocate memory\n");
+        free(cells.words);
+        free(groups.waiting);
+        return;
+    }
+    groups.number_of_groups = 0;
+    struct lane_group first = {number_of_lanes == LANES ? ~(uint64_t) 0 : ((uint64_t) 1 << number_of_lanes) - 1, 0, 0, 0};
+    add_lane_group(&groups, &first);
+
+    while (groups.number_of_groups > 0) {
+        // Takes the group at the earliest instruction
+        unsigned int earliest = 0;
+        for (unsigned int i = 1; i < groups.number_of_groups; i++) {
+            if (groups.groups[i].instruction_index < groups.groups[earliest].instruction_index)
+                earliest = i;
+        }
+        struct lane_group group = groups.groups[earliest];
+        groups.groups[earliest] = groups.groups[--groups.number_of_groups];
+        groups.waiting[group.instruction_index]--;
+
+        uint64_t lanes = group.lanes;
+        unsigned long instruction_index = group.instruction_index;
+        size_t current_bit = group.current_bit;
+        size_t last_bit = group.last_bit;
+
+        // Runs the group until it splits, finishes, meets a waiting group or uses up its turn
+        // split holds the lanes leaving the group for the target of a branch
+        uint64_t split = 0;
+        unsigned long split_target = 0;
+        int out_of_memory = 0;
+        for (unsigned int slice = ENSEMBLE_SLICE; slice > 0 && lanes != 0 && split == 0; slice--) {
+            if (slice != ENSEMBLE_SLICE && can_join(&groups, instruction_index, current_bit, last_bit))
+                break;
+
+            struct instruction *instruction = &program[instruction_index];
+            switch (instruction->opcode) {
+                case ADVANCE:
+                case ADVANCE_BRANCH: {
+                    if (advance_lanes(&cells, lanes, &current_bit, &last_bit, instruction->count)) {
+                        out_of_memory = 1;
+                        break;
+                    }
+                    if (instruction->opcode == ADVANCE) {
+                        instruction_index++;
+                        break;
+                    }
+                } // Fall through
+
+                case BRANCH: {
+                    cells.words[current_bit] ^= lanes;
+                    uint64_t ones = cells.words[current_bit] & lanes;
+                    if (ones == lanes)
+                        instruction_index = instruction->target;
+                    else {
+                        split = ones;
+                        split_target = instruction->target;
+                        instruction_index++;
+                    }
+                } break;
+
+                case CLEAR: {
+                    cells.words[current_bit] &= ~lanes;
+                    instruction_index++;
+                } break;
+
+                // Each lane stops at its own one cell, so the lanes finding one first leave the group where they find it
+                case SCAN: {
+                    if (advance_lanes(&cells, lanes, &current_bit, &last_bit, 1)) {
+                        out_of_memory = 1;
+                        break;
+                    }
+                    uint64_t searching = lanes;
+                    while (1) {
+                        current_bit = find_lanes_one(&cells, searching, current_bit, last_bit);
+                        if (current_bit > last_bit) {
+                            current_bit = 0;
+                            if (add_sliced_cell(&cells, &last_bit)) {
+                                out_of_memory = 1;
+                                break;
+                            }
+                            continue;
+                        }
+
+                        uint64_t found = cells.words[current_bit] & searching;
+                        cells.words[current_bit] ^= found;
+                        if (found == searching)
+                            break;
+                        struct lane_group finished_search = {found, instruction_index + 1, current_bit, last_bit};
+                        add_lane_group(&groups, &finished_search);
+                        searching &= ~found;
+                        if (current_bit != last_bit)
+                            current_bit++;
+                        else {
+                            current_bit = 0;
+                            if (add_sliced_cell(&cells, &last_bit)) {
+                                out_of_memory = 1;
+                                break;
+                            }
+                        }
+                    }
+                    lanes = searching;
+                    instruction_index++;
+                } break;
+
+                case GENERAL_STATE: {
+                    if (instruction->inputs == 0)
+                        cells.words[current_bit] ^= lanes;
+                    else {
+                        // A lane whose input has ended stops there, as the program would
+                        for (uint64_t rest = lanes; rest != 0; rest &= rest - 1) {
+                            unsigned int lane = lowest_one_bit(rest);
+                            begin_io(&io[lane]);
+                            int input_bit = read_input_bits(&io[lane], instruction->inputs);
+                            if (input_bit < 0)
+                                lanes &= ~((uint64_t) 1 << lane);
+                            else if (input_bit)
+                                cells.words[current_bit] |= (uint64_t) 1 << lane;
+                            else
+                                cells.words[current_bit] &= ~((uint64_t) 1 << lane);
+                        }
+                    }
+
+                    uint64_t ones = cells.words[current_bit] & lanes;
+                    if (instruction->outputs != 0) {
+                        for (uint64_t rest = lanes; rest != 0; rest &= rest - 1) {
+                            unsigned int lane = lowest_one_bit(rest);
+                            for (unsigned char i = instruction->outputs; i > 0; i--)
+                                write_output_bit(&io[lane], (ones >> lane) & 1);
+                        }
+                    }
+
+                    if (instruction->will_move_pointer) {
+                        if (current_bit != last_bit)
+                            current_bit++;
+                        else {
+                            current_bit = 0;
+                            if (add_sliced_cell(&cells, &last_bit)) {
+                                out_of_memory = 1;
+                                break;
+                            }
+                        }
+                        instruction_index++;
+                    } else if (ones == lanes)
+                        instruction_index = instruction->target;
+                    else {
+                        split = ones;
+                        split_target = instruction->target;
+                        instruction_index++;
+                    }
+                } break;
+
+                case HALT: {
+                    for (uint64_t rest = lanes; rest != 0; rest &= rest - 1)
+                        end_io(&io[lowest_one_bit(rest)]);
+                    lanes = 0;
+                } break;
+            }
+            if (out_of_memory)
+                break;
+        }
+
+        if (out_of_memory) {
+            fprintf(stderr, "Failed to allocate memory\n");
+            break;
+        }
+        if (split != 0) {
+            struct lane_group taken = {split, split_target, current_bit, last_bit};
+            lanes &= ~split;
+            add_lane_group(&groups, &taken);
+        }
+        if (lanes != 0) {
+            struct lane_group rest = {lanes, instruction_index, current_bit, last_bit};
+            add_lane_group(&groups, &rest);
+        }
+    }
+
+    free(cells.words);
+    free(groups.waiting);
+}
+
+// Compiles the states into superinstructions as run_states() does, then runs them on every lane
+void run_ensemble_states(struct state_table *table, struct io io[], unsigned int number_of_lanes) {
+    unsigned long number_of_states = table->number_of_states;
+    if (thread_branches(table->states, number_of_states)) {
+        fprintf(stderr, "Failed to allocate memory\n");
+        return;
+    }
+    struct instruction *program = malloc((number_of_states + 1) * sizeof(struct instruction));
+    if (program == NULL) {
+        fprintf(stderr, "Failed to allocate memory\n");
+        return;
+    }
+    unsigned long number_of_instructions = compile_superinstructions(table->states, number_of_states, program);
+    if (number_of_instructions != 0)
+        number_of_instructions = remove_unreachable_instructions(program, number_of_instructions);
+    if (number_of_instructions != 0)
+        run_ensemble(program, number_of_instructions, io, number_of_lanes);
+    free(program);
 }
 
-// Deterimines the operator associated with a two-byte character
-unsigned char identify_two_byte_operator(char string[], size_t index) {
-    switch (string[index]) {
-        // Eastern Arabic numerals
-        case '\xD9': {
-            switch (string[index+1]) {
-                case '\xA0': return '0';
-                case '\xA1': return '1';
-                case '\xA2': return '2';
-                case '\xA3': return '3';
+
+
+// Jobs
+
+#if defined(__unix__) || defined(__APPLE__)
+
+// A program run by --jobs, along with the files it reads its input from and writes its output to
+struct job {
+    char *program_file_name;
+    char *input_file_name;   // Empty for a program given no input
+    char *output_file_name;
+    unsigned char failed;
+};
+
+// The jobs of one worker thread not yet started, from next up to end
+// A worker runs its own jobs from the front, and once they run out it steals jobs from the back of another worker's
+// range, so that workers given quick jobs help the others instead of waiting for them
+struct job_range {
+    pthread_mutex_t lock;
+    size_t next;
+    size_t end;
+};
+
+// Variables shared by the worker threads
+// With --ensemble, the ranges hold ensembles rather than jobs, where ensemble i is made of the jobs from
+// ensemble_starts[i] up to ensemble_starts[i + 1] in ensemble_jobs
+struct job_pool {
+    struct job *jobs;
+    struct job **ensemble_jobs;   // NULL without --ensemble
+    size_t *ensemble_starts;
+    struct job_range *ranges;  // One for each worker thread
+    unsigned int number_of_threads;
+};
+
+// The argument passed to each worker thread
+struct worker {
+    struct job_pool *pool;
+    unsigned int index;
+};
+
+// Splits the list chosen by --jobs into jobs, one for each line holding a program, an input file and an output file
+// separated by tabs, and sets number_of_jobs
+// The jobs point into the list rather than copying the file names out of it
+// Returns NULL if a line is not a job or memory could not be allocated
+struct job* read_jobs(char list[], char file_name[], size_t *number_of_jobs) {
+    size_t capacity = 64;
+    struct job *jobs = malloc(capacity * sizeof(struct job));
+    if (jobs == NULL) {
+        fprintf(stderr, "Failed to allocate memory\n");
+        return NULL;
+    }
+
+    *number_of_jobs = 0;
+    char *line = list;
+    for (unsigned long line_number = 1; *line != '\0'; line_number++) {
+        char *end = line + strcspn(line, "\n");
+        char *next_line = *end == '\n' ? end + 1 : end;
+        *end = '\0';
+        if (end > line && end[-1] == '\r')
+            end[-1] = '\0';
+
+        // Blank lines are skipped
+        if (*line != '\0') {
+            char *input_tab = strchr(line, '\t');
+            char *output_tab = input_tab == NULL ? NULL : strchr(input_tab + 1, '\t');
+            if (output_tab == NULL || output_tab[1] == '\0' || strchr(output_tab + 1, '\t') != NULL || input_tab == line) {
+                fprintf(stderr, "Line %lu of %s is not a program, input file and output file separated by tabs\n", line_number, file_name);
+                free(jobs);
+                return NULL;
             }
-        } break;
+            *input_tab = '\0';
+            *output_tab = '\0';
 
-        // Persian numerals
-        case '\xDB': {
-            switch (string[index+1]) {
-                case '\xB0': return '0';
-                case '\xB1': return '1';
-                case '\xB2': return '2';
-                case '\xB3': return '3';
+            if (*number_of_jobs == capacity) {
+                struct job *new_jobs = realloc(jobs, capacity * 2 * sizeof(struct job));
+                if (new_jobs == NULL) {
+                    fprintf(stderr, "Failed to allocate memory\n");
+                    free(jobs);
+                    return NULL;
+                }
+                jobs = new_jobs;
+                capacity *= 2;
             }
-        } break;
+            jobs[*number_of_jobs] = (struct job) {line, input_tab + 1, output_tab + 1, 0};
+            (*number_of_jobs)++;
+        }
+        line = next_line;
     }
-
-    return 'N';
+    return jobs;
 }
 
-// Initializes code arrays to be used by the run_program() function and calls run_program()
-void read_program(char code[]) {
-    unsigned long number_of_states = 1;
-    size_t code_index = 0;
-    unsigned char c = code[0];
+// Runs a job's program with its own input and output, as if by --input and --output
+// Returns 1 if the program could not be read or the job's files could not be opened
+int run_job(struct job *job) {
+    FILE *file = fopen(job->program_file_name, "rb");
+    if (file == NULL) {
+        fprintf(stderr, "Failed to open file %s\n", job->program_file_name);
+        return 1;
+    }
+    char *code = read_code(file);
+    fclose(file);
+    if (code == NULL) {
+        fprintf(stderr, "Failed to allocate memory\n");
+        return 1;
+    }
 
-    // Calculates the number of states needed to initialize the array
-    while (c != '\0') {
-        if (c > 0xEF)
-            code_index += 4;
-        else if (c > 0xDF) {
-            if (identify_three_byte_operator(code, code_index) == '1')
-                number_of_states++;
-            code_index += 3;
-        } else if (c > 0xBF) {
-            if (identify_two_byte_operator(code, code_index) == '1')
-                number_of_states++;
-            code_index += 2;
-        } else {
-            if (c == '1')
-                number_of_states++;
-            code_index++;
+    struct state_table table;
+    if (parse_program(code, &table)) {
+        free(code);
+        return 1;
+    }
+
+    // Every job reads batch input, so a job without an input file reads an empty one
+    struct input job_input;
+    struct output job_output;
+    memset(&job_output, 0, sizeof(job_output));
+    int failed = 1;
+    if (open_input(&job_input, job->input_file_name[0] != '\0' ? job->input_file_name : "/dev/null") == 0) {
+        if (open_output(&job_output, job->output_file_name) == 0) {
+            run_state_table(&table, &job_output, &job_input);
+            close_output(&job_output);
+            failed = 0;
         }
-        c = code[code_index];
+        close_input(&job_input);
     }
+    free(table.states);
+    free(code);
+    return failed;
+}
+
+// Runs up to 64 jobs with the same program as one ensemble, each as run_job() would run it, and sets which failed
+void run_job_ensemble(struct job *jobs[], unsigned int number_of_jobs) {
+    for (unsigned int i = 0; i < number_of_jobs; i++)
+        jobs[i]->failed = 1;
 
-    // Displays error message if there are too many states, which would cause the
-    // the code arrays to use a lot of memory (currently limited to 6.5 megabytes)
-    if (number_of_states > 524288) {
-        fprintf(stderr, "Code uses too many states, exceeding limits on memory\n");
+    FILE *file = fopen(jobs[0]->program_file_name, "rb");
+    if (file == NULL) {
+        fprintf(stderr, "Failed to open file %s\n", jobs[0]->program_file_name);
+        return;
+    }
+    char *code = read_code(file);
+    fclose(file);
+    if (code == NULL) {
+        fprintf(stderr, "Failed to allocate memory\n");
+        return;
+    }
+    struct state_table table;
+    if (parse_program(code, &table)) {
+        free(code);
         return;
     }
 
-    // Initializes code arrays used for running the program
-    unsigned long next_states[number_of_states];
-    unsigned char will_move_pointer[number_of_states];
-    unsigned char outputs[number_of_states];
-    unsigned char inputs[number_of_states];
-    outputs[0] = 0;
-    inputs[0] = 0;
+    // Jobs whose files cannot be opened are left out, so the lanes hold only the others
+    struct input inputs[LANES];
+    struct output outputs[LANES];
+    struct io io[LANES];
+    struct job *lanes[LANES];
+    unsigned int number_of_lanes = 0;
+    for (unsigned int i = 0; i < number_of_jobs; i++) {
+        struct job *job = jobs[i];
+        struct input *job_input = &inputs[number_of_lanes];
+        struct output *job_output = &outputs[number_of_lanes];
+        memset(job_output, 0, sizeof(struct output));
+        if (open_input(job_input, job->input_file_name[0] != '\0' ? job->input_file_name : "/dev/null"))
+            continue;
+        if (open_output(job_output, job->output_file_name)) {
+            close_input(job_input);
+            continue;
+        }
+        if (initialize_io(&io[number_of_lanes], job_output, job_input)) {
+            fprintf(stderr, "Failed to allocate memory\n");
+            close_output(job_output);
+            close_input(job_input);
+            continue;
+        }
+        lanes[number_of_lanes++] = job;
+    }
 
-    unsigned long number_of_zeroes = 0;
-    unsigned long state_index = 0;
-    code_index = 0;
-    c = code[0];
+    if (number_of_lanes != 0)
+        run_ensemble_states(&table, io, number_of_lanes);
+    for (unsigned int lane = 0; lane < number_of_lanes; lane++) {
+        free_io(&io[lane]);
+        close_output(&outputs[lane]);
+        close_input(&inputs[lane]);
+        lanes[lane]->failed = 0;
+    }
+    free(table.states);
+    free(code);
+}
 
-    // Stores all values into the code arrays based on the submitted code
-    while (c != '\0') {
-        if (c > 0xEF)
-            code_index += 4;
-        else if (c > 0xDF) {
-            c = identify_three_byte_operator(code, code_index);
-            code_index += 3;
-        } else if (c > 0xBF) {
-            c = identify_two_byte_operator(code, code_index);
-            code_index += 2;
-        } else {
-            code_index++;
-        }
+// Orders jobs by the program they run, keeping the order of the list among jobs with the same program
+int compare_job_programs(const void *first, const void *second) {
+    struct job *first_job = *(struct job**) first, *second_job = *(struct job**) second;
+    int comparison = strcmp(first_job->program_file_name, second_job->program_file_name);
+    if (comparison != 0)
+        return comparison;
+    return first_job < second_job ? -1 : first_job > second_job;
+}
 
-        switch (c) {
-            case '0': {
-                number_of_zeroes++;
-            } break;
+// Sets job to the next job a worker should run, taken from the front of its own range or else from the back of another
+// Returns 0 once every range is empty
+int take_job(struct job_pool *pool, unsigned int worker, size_t *job) {
+    for (unsigned int i = 0; i < pool->number_of_threads; i++) {
+        struct job_range *range = &pool->ranges[(worker + i) % pool->number_of_threads];
+        pthread_mutex_lock(&range->lock);
+        int found = range->next < range->end;
+        if (found)
+            *job = i == 0 ? range->next++ : --range->end;
+        pthread_mutex_unlock(&range->lock);
+        if (found)
+            return 1;
+    }
+    return 0;
+}
 
-            case '1': {
-                if (number_of_zeroes > 0) {
-                    will_move_pointer[state_index] = 0;
-                    next_states[state_index] = state_index - number_of_zeroes + 1;
-                    while (next_states[state_index] > 524288)
-                        next_states[state_index] += number_of_states + 1;
-                } else
-                    will_move_pointer[state_index] = 255;
-                number_of_zeroes = 0;
-                state_index++;
-                outputs[state_index] = 0;
-                inputs[state_index] = 0;
-            } break;
+// Runs jobs until there are none left
+void* run_worker(void *argument) {
+    struct worker *worker = argument;
+    struct job_pool *pool = worker->pool;
+    size_t job;
+    while (take_job(pool, worker->index, &job)) {
+        if (pool->ensemble_jobs != NULL) {
+            size_t start = pool->ensemble_starts[job];
+            run_job_ensemble(pool->ensemble_jobs + start, pool->ensemble_starts[job + 1] - start);
+        } else
+            pool->jobs[job].failed = run_job(&pool->jobs[job]);
+    }
+    return NULL;
+}
 
-            case '2': {
-                if (++outputs[state_index] == 255) {
-                    fprintf(stderr, "Too many output operators in one state\nTry separating them into multiple states\n");
-                    return;
-                }
-            } break;
+// Runs every job in the list in file_name across a pool of worker threads, one for each core unless --threads is given
+// The main thread works as well, and a range whose thread could not be created is taken over by the other workers
+// Returns 1 if the list could not be read or a job failed
+int run_jobs(char file_name[]) {
+    FILE *file = fopen(file_name, "rb");
+    if (file == NULL) {
+        fprintf(stderr, "Failed to open file %s\n", file_name);
+        return 1;
+    }
+    char *list = read_code(file);
+    fclose(file);
+    if (list == NULL) {
+        fprintf(stderr, "Failed to allocate memory\n");
+        return 1;
+    }
 
-            case '3': {
-                if (++inputs[state_index] == 255) {
-                    fprintf(stderr, "Too many input operators in one state\nTry separating them into multiple states\n");
-                    return;
-                }
-            } break;
+    struct job_pool pool;
+    size_t number_of_jobs;
+    pool.jobs = read_jobs(list, file_name, &number_of_jobs);
+    if (pool.jobs == NULL) {
+        free(list);
+        return 1;
+    }
+
+    // --ensemble sorts the jobs by program and splits each program's jobs into ensembles of up to 64, which the workers
+    // take in place of single jobs
+    size_t number_of_tasks = number_of_jobs;
+    pool.ensemble_jobs = NULL;
+    pool.ensemble_starts = NULL;
+    if (options.ensemble) {
+        pool.ensemble_jobs = malloc((number_of_jobs + 1) * sizeof(struct job*));
+        pool.ensemble_starts = malloc((number_of_jobs + 1) * sizeof(size_t));
+        if (pool.ensemble_jobs == NULL || pool.ensemble_starts == NULL) {
+            fprintf(stderr, "Failed to allocate memory\n");
+            free(pool.ensemble_jobs);
+            free(pool.ensemble_starts);
+            free(pool.jobs);
+            free(list);
+            return 1;
         }
-        c = code[code_index];
+        for (size_t i = 0; i < number_of_jobs; i++)
+            pool.ensemble_jobs[i] = &pool.jobs[i];
+        qsort(pool.ensemble_jobs, number_of_jobs, sizeof(struct job*), compare_job_programs);
+        number_of_tasks = 0;
+        for (size_t i = 0; i < number_of_jobs; i++) {
+            size_t start = number_of_tasks == 0 ? 0 : pool.ensemble_starts[number_of_tasks - 1];
+            if (i == 0 || i - start == LANES || strcmp(pool.ensemble_jobs[i]->program_file_name, pool.ensemble_jobs[start]->program_file_name) != 0)
+                pool.ensemble_starts[number_of_tasks++] = i;
+        }
+        pool.ensemble_starts[number_of_tasks] = number_of_jobs;
     }
 
-    // Repetition of code from case '1', which is needed for every state
-    if (number_of_zeroes > 0) {
-        will_move_pointer[state_index] = 0;
-        next_states[state_index] = state_index - number_of_zeroes + 1;
-        while (next_states[state_index] > 524288)
-            next_states[state_index] += number_of_states + 1;
-    } else
-        will_move_pointer[state_index] = 255;
+    long cores = sysconf(_SC_NPROCESSORS_ONLN);
+    pool.number_of_threads = options.number_of_threads != 0 ? options.number_of_threads : cores > 0 ? (unsigned int) cores : 1;
+    if (pool.number_of_threads > number_of_tasks)
+        pool.number_of_threads = number_of_tasks > 0 ? (unsigned int) number_of_tasks : 1;
+    pool.ranges = malloc(pool.number_of_threads * sizeof(struct job_range));
+    struct worker *workers = malloc(pool.number_of_threads * sizeof(struct worker));
+    pthread_t *threads = malloc(pool.number_of_threads * sizeof(pthread_t));
+    unsigned char *started = calloc(pool.number_of_threads, sizeof(unsigned char));
+    if (pool.ranges == NULL || workers == NULL || threads == NULL || started == NULL) {
+        fprintf(stderr, "Failed to allocate memory\n");
+        free(pool.ranges);
+        free(workers);
+        free(threads);
+        free(started);
+        free(pool.ensemble_jobs);
+        free(pool.ensemble_starts);
+        free(pool.jobs);
+        free(list);
+        return 1;
+    }
+
+    // Each worker begins with an equal share of the jobs, in the order they are listed
+    for (unsigned int i = 0; i < pool.number_of_threads; i++) {
+        pthread_mutex_init(&pool.ranges[i].lock, NULL);
+        pool.ranges[i].next = number_of_tasks * i / pool.number_of_threads;
+        pool.ranges[i].end = number_of_tasks * (i + 1) / pool.number_of_threads;
+        workers[i] = (struct worker) {&pool, i};
+    }
+    for (unsigned int i = 1; i < pool.number_of_threads; i++)
+        started[i] = pthread_create(&threads[i], NULL, run_worker, &workers[i]) == 0;
+    run_worker(&workers[0]);
+    for (unsigned int i = 1; i < pool.number_of_threads; i++) {
+        if (started[i])
+            pthread_join(threads[i], NULL);
+    }
 
-    run_program(next_states, will_move_pointer, outputs, inputs, number_of_states);
+    size_t failed = 0;
+    for (size_t i = 0; i < number_of_jobs; i++)
+        failed += pool.jobs[i].failed;
+    if (failed != 0)
+        fprintf(stderr, "%zu of %zu jobs failed\n", failed, number_of_jobs);
+
+    for (unsigned int i = 0; i < pool.number_of_threads; i++)
+        pthread_mutex_destroy(&pool.ranges[i].lock);
+    free(pool.ranges);
+    free(workers);
+    free(threads);
+    free(started);
+    free(pool.ensemble_jobs);
+    free(pool.ensemble_starts);
+    free(pool.jobs);
+    free(list);
+    return failed != 0;
 }
 
+#else
 
+int run_jobs(char file_name[]) {
+    fprintf(stderr, "--jobs runs programs in threads, which is only supported on Unix-like systems\n");
+    return 1;
+}
 
-// Input Code
+#endif
 
-// Opens file, records the code contained inside, and calls read_program()
-int read_code_from_file(char file_name[]) {
-    FILE *file;
-    file = fopen(file_name, "r");
-    if (file == NULL) {
-        fprintf(stderr, "File not found\n");
-        return 1;
+
+
+// Library
+
+// A program compiled by axios_compile(), holding its states as parsed
+struct axios_program {
+    struct state_table table;
+};
+
+// A program run by axios_run() a number of steps at a time, holding everything run_profiled() keeps in local variables
+// Output is kept in a buffer that grows until the caller takes it, rather than being written to a file
+struct axios_machine {
+    struct state *states;
+    unsigned long number_of_states;
+    unsigned long state;
+    struct cells cells;
+    size_t current_bit;
+    struct input_queue queue;
+    unsigned long output_utf_32;
+    unsigned long toggle_output;
+    unsigned char *output;
+    size_t output_size;
+    size_t output_capacity;
+    uint64_t steps;
+};
+
+struct axios_program* axios_compile(const char code[], size_t length, enum axios_compile_status *status) {
+    enum axios_compile_status ignored_status;
+    if (status == NULL)
+        status = &ignored_status;
+    struct axios_program *program = malloc(sizeof(struct axios_program));
+
+    // As with read_code(), four null characters follow the code, since a character may be read past its first byte
+    char *terminated_code = malloc(length + 4);
+    if (program == NULL || terminated_code == NULL) {
+        free(program);
+        free(terminated_code);
+        *status = AXIOS_COMPILE_OUT_OF_MEMORY;
+        return NULL;
     }
+    memcpy(terminated_code, code, length);
+    memset(terminated_code + length, 0, 4);
 
-    char code[131072] = {0};
-    size_t code_index = 0;
+    // parse_states() is used rather than parse_program(), so that nothing is printed
+    *status = parse_states(terminated_code, &program->table);
+    free(terminated_code);
+    if (*status != AXIOS_COMPILED) {
+        free(program);
+        return NULL;
+    }
+    return program;
+}
 
-    while ((code[code_index] = fgetc(file)) != EOF) {
-        if (++code_index == 131072) {
-            fprintf(stderr, "Code is too long, exceeding limits on memory");
-            return 1;
-        }
+void axios_free_program(struct axios_program *program) {
+    if (program == NULL)
+        return;
+    free(program->table.states);
+    free(program);
+}
+
+struct axios_machine* axios_create_machine(const struct axios_program *program) {
+    struct axios_machine *machine = malloc(sizeof(struct axios_machine));
+    if (machine == NULL)
+        return NULL;
+    if (initialize_cells(&machine->cells)) {
+        free(machine);
+        return NULL;
+    }
+    if (initialize_input_queue(&machine->queue)) {
+        free_cells(&machine->cells);
+        free(machine);
+        return NULL;
     }
+    machine->states = program->table.states;
+    machine->number_of_states = program->table.number_of_states;
+    machine->state = 0;
+    machine->current_bit = 0;
+    machine->output_utf_32 = 0;
+    machine->toggle_output = 0x00000001;
+    machine->output = NULL;
+    machine->output_size = 0;
+    machine->output_capacity = 0;
+    machine->steps = 0;
+    return machine;
+}
 
-    fclose(file);
-    read_program(code);
-    return 0;
+void axios_free_machine(struct axios_machine *machine) {
+    if (machine == NULL)
+        return;
+    free_cells(&machine->cells);
+    free_input_queue(&machine->queue);
+    free(machine->output);
+    free(machine);
 }
 
-// Reads a file name from user input
-void input_file_name(char file_name[]) {
-    printf("\nType the name of your file: ");
-    fgets(file_name, 2, stdin); // Buffer function needed, or no user input will be read
-    fgets(file_name, 256, stdin);
+// Runs one state at a time as run_profiled() does, keeping the pointer in local variables until the machine pauses
+// A state needing input is left unrun, so that it runs again from the beginning once input has been supplied
+enum axios_status axios_run(struct axios_machine *machine, uint64_t steps) {
+    struct state *states = machine->states;
+    struct cells *cells = &machine->cells;
+    unsigned long state = machine->state;
+    size_t current_bit = machine->current_bit;
+    uint64_t *word_pointer = word_address(cells, current_bit / 64);
+    uint64_t toggle_bit = (uint64_t) 1 << current_bit % 64;
+    enum axios_status status = AXIOS_PAUSED;
+    if (word_pointer == NULL)
+        return AXIOS_OUT_OF_MEMORY;
 
-    // Replaces the newline character at the end of file_name with the null character, so the correct file name will be passed to fopen()
-    for (int i = 0; i < 255; i++) {
-        if (file_name[i] == '\n') {
-            file_name[i] = '\0';
+    uint64_t step = 0;
+    for (; step < steps; step++) {
+        if (state == machine->number_of_states) {
+            status = AXIOS_FINISHED;
             break;
         }
-    }
-    
-     // Ensures the last character is the null character in case the user's input exceeded the length of file_name
-    file_name[255] = '\0';
-}
 
-// Reads file name from argument(s) at program start
-int get_file_from_argv(char file_name[], int argc, char **argv) {
-    size_t index = 0;
-    
-    // Iteratively adds the characters of all arguments to file_name
-    for (size_t i = 1; i < argc; i++) {
-        char *ch;
-        ch = &(argv[i][0]);
-        
-        // Adds each character in a single argument to file_name
-        while (*ch != '\0') {
-            file_name[index] = *ch;
-            index++; ch++;
-            if (index >= 256) {
-                printf("The name of your file or path is too long");
-                return 1;
+        if (states[state].inputs == 0)
+            *word_pointer ^= toggle_bit;
+        else {
+            if (machine->queue.size * 21 - machine->queue.current_input_bit < states[state].inputs) {
+                status = AXIOS_NEEDS_INPUT;
+                break;
             }
+            skip_input_bits(&machine->queue, states[state].inputs - 1);
+            if (remove_input_bit(&machine->queue))
+                *word_pointer |= toggle_bit;
+            else
+                *word_pointer &= ~toggle_bit;
         }
-        
-        // In the command line, two arguments are separated by a space
-        // I add the space here to treat that space as part of the file name
-        if (i != argc - 1) {
-            file_name[index] = ' ';
-            index++;
-            if (index >= 256) {
-                printf("The name of your file or path is too long");
-                return 1;
+
+        // Outputs bits as write_output_bit() does, adding each character to the output buffer
+        for (unsigned char i = states[state].outputs; i > 0; i--) {
+            if (*word_pointer & toggle_bit)
+                machine->output_utf_32 ^= machine->toggle_output;
+            if (machine->toggle_output != 0x00100000) {
+                machine->toggle_output <<= 1;
+                continue;
+            }
+            machine->toggle_output = 0x00000001;
+            if (machine->output_utf_32 == 0x1FFFFF)
+                clear_queue(&machine->queue);
+            else {
+                if (machine->output_size + 4 > machine->output_capacity) {
+                    size_t capacity = machine->output_capacity == 0 ? 256 : machine->output_capacity * 2;
+                    unsigned char *output = realloc(machine->output, capacity);
+                    if (output == NULL) {
+                        status = AXIOS_OUT_OF_MEMORY;
+                        break;
+                    }
+                    machine->output = output;
+                    machine->output_capacity = capacity;
+                }
+                machine->output_size += encode_utf_8(machine->output_utf_32, machine->output + machine->output_size);
             }
+            machine->output_utf_32 = 0;
         }
+        if (status == AXIOS_OUT_OF_MEMORY)
+            break;
+
+        if (states[state].will_move_pointer) {
+            if (current_bit != cells->last_bit) {
+                current_bit++;
+                toggle_bit <<= 1;
+                if (toggle_bit == 0) {
+                    word_pointer = current_bit % CHUNK_BITS == 0 ? word_address(cells, current_bit / 64) : word_pointer + 1;
+                    toggle_bit = 1;
+                    if (word_pointer == NULL) {
+                        status = AXIOS_OUT_OF_MEMORY;
+                        break;
+                    }
+                }
+            } else {
+                if (add_cell(cells)) {
+                    status = AXIOS_OUT_OF_MEMORY;
+                    break;
+                }
+                current_bit = 0;
+                word_pointer = cells->chunks[0];
+                toggle_bit = 1;
+            }
+            state++;
+        } else if (*word_pointer & toggle_bit)
+            state = states[state].next_state;
+        else
+            state++;
     }
-    
-    // Marks the end of the file name
-    file_name[index] = '\0';
+
+    // The termination state is reported as soon as it is reached, even by the last step given
+    if (status == AXIOS_PAUSED && state == machine->number_of_states)
+        status = AXIOS_FINISHED;
+    machine->steps += step;
+    machine->state = state;
+    machine->current_bit = current_bit;
+    return status;
 }
 
-// Runs the shell and calls read_program() until "2" is entered
-void run_shell() {
-    char code[131072] = {0};
-    size_t code_index = 0;
-    fgets(code, 2, stdin); // Buffer function needed, or no user input will be read
-    printf("\n>>> ");
-    fgets(code, 131072, stdin);
+int axios_supply_input(struct axios_machine *machine, const char input[], size_t length) {
+    size_t size = machine->queue.size;
+    size_t decoded;
+    if (decode_inputs(&machine->queue, (unsigned char*) input, length, &decoded) != DECODED)
+        return 1;
+    if (decoded != length) {
+        machine->queue.size = size;
+        return 1;
+    }
+    return 0;
+}
 
-    while ((code[0] != '2' || code[1] != '\n')  && (identify_two_byte_operator(code, 0) != '2' || code[2] != '\n') && (identify_three_byte_operator(code, 0) != '2' || code[3] != '\n')) {
-        if (code[131071] == '\0')
-            read_program(code);
-        else
-            fprintf(stderr, "Code is too long, exceeding limits on memory");
+size_t axios_take_output(struct axios_machine *machine, char buffer[], size_t size) {
+    if (size > machine->output_size)
+        size = machine->output_size;
+    memcpy(buffer, machine->output, size);
+    memmove(machine->output, machine->output + size, machine->output_size - size);
+    machine->output_size -= size;
+    return size;
+}
 
-        code_index = 0;
-        while (code_index < 131072) {
-            code[code_index] = '\0';
-            code_index++;
-        }
-        printf("\n>>> ");
-        fgets(code, 131072, stdin);
-    }
+uint64_t axios_steps(const struct axios_machine *machine) {
+    return machine->steps;
 }
 
 
@@ -688,21 +5750,68 @@ void menu() {
     printf("\n");
 }
 
+#if !defined(AXIOS_LIBRARY)
+
 // Checks for file name arguments and decides which function is called
 int main(int argc, char **argv) {
-    // If there is just one argument, and no file name, the menu function is called
-    if (argc == 1) {
-        menu();
-        return 0;
-    }
-    
-    // If file name argument(s) exist (i.e. more than one argument),
-    // a function to interpret the argument(s) and make the file_name is called
+    if (get_options_from_argv(argc, argv) == 1 || open_output(&output, options.output_file_name) == 1)
+        return 1;
+
+    // A function to interpret the argument(s) that are not options and make the file_name is called
     char file_name[256];
     if (get_file_from_argv(file_name, argc, argv) == 1)
         return 1;
+
+    if (options.benchmark)
+        return run_benchmarks(file_name);
+
+    // Each job has its own program, input and output, and runs alongside others, so options that name a single file for
+    // the program or that rely on signals cannot be used with them
+    if (options.jobs_file_name != NULL) {
+        if (file_name[0] != '\0' || options.c_file_name != NULL || options.profile_file_name != NULL || options.checkpoint_file_name != NULL || options.resume_file_name != NULL || options.batch_input || options.output_file_name != NULL || options.cache_file_name != NULL || options.counters || options.async_io) {
+            fprintf(stderr, "--jobs takes each program, input and output from its list, and cannot be used with a file name, --emit-c, --profile, --checkpoint, --resume, --batch, --input, --output, --cache, --counters or --async-io\n");
+            return 1;
+        }
+        return run_jobs(options.jobs_file_name);
+    }
+    if (options.ensemble) {
+        fprintf(stderr, "--ensemble runs the jobs chosen by --jobs, and cannot be used without it\n");
+        return 1;
+    }
+
+    // Batch input opens its file before any program runs, and cannot read standard input alongside the menu
+    if (options.batch_input) {
+        if (file_name[0] == '\0' && options.batch_file_name == NULL) {
+            fprintf(stderr, "--batch reads standard input, so it needs a program file rather than the menu\n");
+            return 1;
+        }
+        if (open_input(&input, options.batch_file_name))
+            return 1;
+    }
+
+    // Output, and batch input, are handed to threads of their own
+    if (options.async_io) {
+#if defined(__unix__) || defined(__APPLE__)
+        output.writer = start_ring(output.file_descriptor, write_behind, 0);
+        if (output.writer == NULL || (options.batch_input && (input.reader = start_ring(input.file_descriptor, read_ahead, 1)) == NULL)) {
+            fprintf(stderr, "Failed to start the threads for --async-io\n");
+            return 1;
+        }
+#else
+        fprintf(stderr, "--async-io reads and writes in threads, which is only supported on Unix-like systems\n");
+        return 1;
+#endif
+    }
+
+    // If there is no file name, the menu function is called
+    if (file_name[0] == '\0') {
+        menu();
+        return 0;
+    }
     
     // If a valid file name was passed, a function to check for said file
     // and (if successful) run code found in the file is called
     return read_code_from_file(file_name);
 }
+
+#endif
@@ -0,0 +1,89 @@
+/*
+MIT License
+
+Copyright (c) 2022 Maxine Dobbs
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+// Functions for running Axios programs from within another program, built into libaxios.a and libaxios.so by the
+// Makefile
+//
+// A program is compiled once, and any number of machines can then run it, each with its own cells array, input and
+// output. A machine runs for as many steps as it is given (one state each) and returns early when it needs input, so a
+// caller can take turns between many machines on one thread. Input is supplied and output collected through buffers,
+// with no extra newlines around them, as with --batch.
+//
+// Machines running in different threads share nothing but their program, which is never changed after compiling.
+
+#ifndef AXIOS_H
+#define AXIOS_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+struct axios_program;
+struct axios_machine;
+
+// Reasons axios_run() returns
+enum axios_status {
+    AXIOS_PAUSED,         // All of the steps given were run
+    AXIOS_NEEDS_INPUT,    // The current state needs more bits of input than have been supplied
+    AXIOS_FINISHED,       // The termination state was reached
+    AXIOS_OUT_OF_MEMORY   // The cells array or the output could not grow, and the machine cannot continue
+};
+
+// Results of axios_compile()
+enum axios_compile_status {
+    AXIOS_COMPILED,
+    AXIOS_COMPILE_OUT_OF_MEMORY,
+    AXIOS_TOO_MANY_ZEROES,   // A state has 2^32 - 1 or more 0 operators
+    AXIOS_TOO_MANY_STATES,   // The code has 2^32 - 1 or more states
+    AXIOS_TOO_MANY_OUTPUTS,  // A state has 255 or more 2 operators
+    AXIOS_TOO_MANY_INPUTS    // A state has 255 or more 3 operators
+};
+
+// Compiles length bytes of code, which end early at a null character, and sets status if it is not NULL
+// Returns NULL if the code has more operators or states than can be stored or memory could not be allocated, with
+// status telling which, and nothing is printed in either case
+struct axios_program* axios_compile(const char code[], size_t length, enum axios_compile_status *status);
+
+void axios_free_program(struct axios_program *program);
+
+// Creates a machine at the beginning of the program, which must not be freed before the machine
+// Returns NULL if memory could not be allocated
+struct axios_machine* axios_create_machine(const struct axios_program *program);
+
+void axios_free_machine(struct axios_machine *machine);
+
+// Runs up to steps states
+enum axios_status axios_run(struct axios_machine *machine, uint64_t steps);
+
+// Adds length bytes of UTF-8 to the machine's input, which must end with a whole character
+// Returns 1 if the input is not valid UTF-8 or memory could not be allocated, in which case none of it is added
+int axios_supply_input(struct axios_machine *machine, const char input[], size_t length);
+
+// Moves up to size bytes of the machine's UTF-8 output into buffer and returns the number of bytes moved
+// A character may be split between two calls
+size_t axios_take_output(struct axios_machine *machine, char buffer[], size_t size);
+
+// Returns the number of steps the machine has run
+uint64_t axios_steps(const struct axios_machine *machine);
+
+#endif